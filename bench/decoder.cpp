@@ -0,0 +1,171 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput of the host decoder implementations for packed readings,
+ * compared to unpacking each Reading, after checking that they all decode
+ * the same values.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "scd30/decoder.h"
+#include "scd30/reading.h"
+
+using scd30::Reading;
+using scd30::READING_FIELDS;
+using scd30::decoder::Implementation;
+
+static constexpr size_t READINGS = 1000003; /* Not a multiple of the vector width */
+static constexpr unsigned int ROUNDS = 20;
+
+static const Implementation IMPLEMENTATIONS[] = {
+	Implementation::SCALAR,
+	Implementation::SSSE3,
+	Implementation::AVX2,
+};
+
+struct Columns {
+	Columns() : timestamp(READINGS) {
+		for (size_t f = 0; f < Reading::FIELDS; f++) {
+			values[f].resize(READINGS);
+			fields[f] = values[f].data();
+		}
+	}
+
+	std::vector<uint32_t> timestamp;
+	std::vector<int32_t> values[Reading::FIELDS];
+	int32_t *fields[Reading::FIELDS];
+};
+
+static std::vector<uint8_t> generate() {
+	std::mt19937 rng{1};
+	std::vector<uint8_t> data(READINGS * Reading::PACKED_BYTES);
+	uint32_t timestamp = 1700000000;
+
+	for (size_t i = 0; i < READINGS; i++) {
+		Reading reading{timestamp += rng() % 60};
+
+		for (size_t f = 0; f < Reading::FIELDS; f++) {
+			const auto &field = READING_FIELDS[f];
+			uint32_t range = field.max() - field.min() + 1;
+
+			/* Include NaN (one more than the range) */
+			reading.set_field(f, field.min() + static_cast<int32_t>(rng() % (range + 1)));
+		}
+
+		reading.pack(&data[i * Reading::PACKED_BYTES]);
+	}
+
+	return data;
+}
+
+static void unpack(const std::vector<uint8_t> &data, Columns &columns) {
+	for (size_t i = 0; i < READINGS; i++) {
+		Reading reading = Reading::unpack(&data[i * Reading::PACKED_BYTES]);
+
+		columns.timestamp[i] = reading.timestamp;
+		for (size_t f = 0; f < Reading::FIELDS; f++) {
+			columns.fields[f][i] = reading.get_field(f);
+		}
+	}
+}
+
+static bool verify(const Columns &expected, const Columns &actual, const char *name) {
+	for (size_t i = 0; i < READINGS; i++) {
+		if (actual.timestamp[i] != expected.timestamp[i]) {
+			std::printf("%s: reading %zu timestamp %u != %u\n", name, i,
+				actual.timestamp[i], expected.timestamp[i]);
+			return false;
+		}
+
+		for (size_t f = 0; f < Reading::FIELDS; f++) {
+			if (actual.values[f][i] != expected.values[f][i]) {
+				std::printf("%s: reading %zu %s %d != %d\n", name, i, READING_FIELDS[f].name,
+					actual.values[f][i], expected.values[f][i]);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+template <typename F>
+static double rate(F fn) {
+	auto start = std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < ROUNDS; i++) {
+		fn();
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	return static_cast<double>(READINGS) * ROUNDS / std::chrono::duration<double>(end - start).count();
+}
+
+int main() {
+	std::vector<uint8_t> data = generate();
+	Columns expected;
+	Columns actual;
+
+	unpack(data, expected);
+
+	for (auto implementation : IMPLEMENTATIONS) {
+		if (!scd30::decoder::available(implementation)) {
+			continue;
+		}
+
+		scd30::decoder::decode(data.data(), READINGS, actual.timestamp.data(), actual.fields, implementation);
+
+		if (!verify(expected, actual, scd30::decoder::name(implementation))) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	scd30::decoder::ReadingColumns columns;
+
+	if (scd30::decoder::decode(data.data(), data.size() + 1, columns) != READINGS
+			|| columns.values(Reading::TEMPERATURE).size() != READINGS) {
+		std::printf("ReadingColumns: wrong number of readings\n");
+		return EXIT_FAILURE;
+	}
+
+	std::printf("%zu readings (%zu bytes), %u rounds\n\n", READINGS, data.size(), ROUNDS);
+	std::printf("%-16s %14s\n", "Implementation", "Readings/s");
+	std::printf("%-16s %14.0f\n", "Reading::unpack", rate([&] { unpack(data, actual); }));
+
+	for (auto implementation : IMPLEMENTATIONS) {
+		if (!scd30::decoder::available(implementation)) {
+			std::printf("%-16s %14s\n", scd30::decoder::name(implementation), "unavailable");
+			continue;
+		}
+
+		std::printf("%-16s %14.0f\n", scd30::decoder::name(implementation), rate([&] {
+			scd30::decoder::decode(data.data(), READINGS, actual.timestamp.data(), actual.fields, implementation);
+		}));
+	}
+
+	std::printf("\nDefault: %s\n", scd30::decoder::name(scd30::decoder::default_implementation()));
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,321 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Fleet load generator: runs many simulated devices in one process, each
+ * with the firmware's own Report implementation (see host/), so that the
+ * requests sent to the endpoint are the same as those from real devices.
+ *
+ * Readings come from an emulated sensor (a random walk at the configured
+ * reading interval) and time is virtual, so the fleet can run faster than
+ * real time. Outages disconnect a random subset of devices from the network
+ * for a period, after which they drain their backlog.
+ *
+ * Each device uses its own upload sequence numbers instead of the persistent
+ * counter that a real device has, so that there are no gaps between them.
+ */
+
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <time.h>
+
+#include "app/config.h"
+#include "host.h"
+#include "scd30/report.h"
+#include "scd30/traffic.h"
+
+using Config = ::app::Config;
+using steady_clock = std::chrono::steady_clock;
+
+static constexpr uint64_t TICK_MS = 10;
+
+struct Device {
+	std::string name;
+	scd30::Report report;
+	uint32_t sequence = 1;
+	uint64_t next_reading_ms;
+	float temperature_c = 21.0f;
+	float relative_humidity_pc = 45.0f;
+	float co2_ppm = 600.0f;
+	bool outage = false;
+};
+
+struct Options {
+	unsigned long devices = 100;
+	std::string url = "http://127.0.0.1:8080/";
+	unsigned long duration_s = 600;
+	double speed = 1.0;
+	unsigned long interval_s = 5;
+	unsigned long threshold = 12;
+	unsigned long pipeline = 1;
+	unsigned long max_latency_s = 0;
+	unsigned long outage_every_s = 0;
+	unsigned long outage_length_s = 60;
+	double outage_fraction = 0.1;
+	unsigned long status_s = 10;
+	int log_level = static_cast<int>(uuid::log::Level::ERR);
+};
+
+static void usage(const char *name) {
+	std::fprintf(stderr, "Usage: %s [options]\n"
+		"  -n DEVICES    Number of simulated devices (100)\n"
+		"  -u URL        Upload URL, http only (http://127.0.0.1:8080/)\n"
+		"  -d SECONDS    Duration in virtual time (600)\n"
+		"  -s SPEED      Virtual time per real time, 0 for as fast as possible\n"
+		"                (but no faster than real time while waiting for a response) (1)\n"
+		"  -i SECONDS    Reading interval (5)\n"
+		"  -t COUNT      Report threshold (12)\n"
+		"  -p COUNT      Report pipeline (1)\n"
+		"  -m SECONDS    Report max latency, 0 to disable (0)\n"
+		"  -o SECONDS    Start an outage this often, 0 for none (0)\n"
+		"  -l SECONDS    Outage length (60)\n"
+		"  -f FRACTION   Fraction of devices affected by each outage (0.1)\n"
+		"  -r SECONDS    Status output interval (10)\n"
+		"  -v LEVEL      Log level, 0 (emerg) to 8 (trace) (3)\n", name);
+}
+
+static bool parse_options(int argc, char *argv[], Options &options) {
+	int opt;
+
+	while ((opt = ::getopt(argc, argv, "n:u:d:s:i:t:p:m:o:l:f:r:v:h")) != -1) {
+		switch (opt) {
+		case 'n': options.devices = std::strtoul(optarg, nullptr, 10); break;
+		case 'u': options.url = optarg; break;
+		case 'd': options.duration_s = std::strtoul(optarg, nullptr, 10); break;
+		case 's': options.speed = std::strtod(optarg, nullptr); break;
+		case 'i': options.interval_s = std::strtoul(optarg, nullptr, 10); break;
+		case 't': options.threshold = std::strtoul(optarg, nullptr, 10); break;
+		case 'p': options.pipeline = std::strtoul(optarg, nullptr, 10); break;
+		case 'm': options.max_latency_s = std::strtoul(optarg, nullptr, 10); break;
+		case 'o': options.outage_every_s = std::strtoul(optarg, nullptr, 10); break;
+		case 'l': options.outage_length_s = std::strtoul(optarg, nullptr, 10); break;
+		case 'f': options.outage_fraction = std::strtod(optarg, nullptr); break;
+		case 'r': options.status_s = std::strtoul(optarg, nullptr, 10); break;
+		case 'v': options.log_level = std::atoi(optarg); break;
+		default: return false;
+		}
+	}
+
+	return options.devices > 0 && options.interval_s > 0 && options.status_s > 0;
+}
+
+/* Sockets are kept open between uploads */
+static void raise_file_limit(unsigned long devices) {
+	rlimit limit;
+
+	if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < devices + 64) {
+		limit.rlim_cur = std::min(static_cast<rlim_t>(devices + 64), limit.rlim_max);
+		::setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+static void emulate_sensor(Device &device, std::mt19937 &rng) {
+	std::normal_distribution<float> step{0.0f, 1.0f};
+
+	device.temperature_c = std::max(10.0f, std::min(35.0f, device.temperature_c + step(rng) * 0.05f));
+	device.relative_humidity_pc = std::max(20.0f, std::min(80.0f, device.relative_humidity_pc + step(rng) * 0.2f));
+	device.co2_ppm = std::max(400.0f, std::min(3000.0f, device.co2_ppm + step(rng) * 10.0f));
+
+	/* Read shortly after the data becomes ready, as with schedule alignment */
+	uint32_t read_ms = ::millis();
+	uint32_t ready_ms = read_ms - std::uniform_int_distribution<uint32_t>{0, 250}(rng);
+
+	device.report.add(::time(nullptr), device.temperature_c, device.relative_humidity_pc, device.co2_ppm,
+		ready_ms, read_ms);
+}
+
+/* Any device waiting for a response from the server */
+static bool receiving(const std::deque<std::unique_ptr<Device>> &devices) {
+	return std::any_of(devices.cbegin(), devices.cend(),
+		[] (const std::unique_ptr<Device> &device) { return device->report.state() == scd30::UploadState::RECEIVE; });
+}
+
+static void print_status(uint64_t now_ms, const std::deque<std::unique_ptr<Device>> &devices,
+		const host::NetworkStats &stats, const host::NetworkStats &previous, unsigned long status_s) {
+	size_t stored = 0;
+	size_t outage = 0;
+
+	for (const auto &device : devices) {
+		stored += device->report.size();
+		outage += device->outage ? 1 : 0;
+	}
+
+	unsigned long requests = stats.requests - previous.requests;
+
+	std::printf("%8.0fs %8.1f req/s %10.0f B/s out %10.0f B/s in %6.0f B/req %9zu stored %6zu offline\n",
+		now_ms / 1000.0, static_cast<double>(requests) / status_s,
+		static_cast<double>(stats.bytes_sent - previous.bytes_sent) / status_s,
+		static_cast<double>(stats.bytes_received - previous.bytes_received) / status_s,
+		requests ? static_cast<double>(stats.payload_bytes - previous.payload_bytes) / requests : 0.0,
+		stored, outage);
+	std::fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+	Options options;
+
+	if (!parse_options(argc, argv, options)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	raise_file_limit(options.devices);
+	host::set_log_level(options.log_level);
+
+	time_t epoch = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	std::mt19937 rng{1};
+	std::deque<std::unique_ptr<Device>> devices;
+	Config config;
+
+	host::set_clock(0, epoch);
+
+	config.report_url(options.url);
+	config.report_username("fleet");
+	config.report_password("fleet");
+	config.report_threshold(options.threshold);
+	config.report_pipeline(options.pipeline);
+	config.report_max_latency(options.max_latency_s);
+	config.take_measurement_interval(options.interval_s);
+
+	for (unsigned long i = 0; i < options.devices; i++) {
+		char name[32];
+
+		std::snprintf(name, sizeof(name), "fleet%05lu", i);
+		config.report_sensor_name(name);
+
+		devices.emplace_back(new Device());
+		devices.back()->name = name;
+
+		/* Each device has its own sequence, like separate devices would */
+		Device *device = devices.back().get();
+		device->report.sequence_source([device] { return device->sequence++; });
+		devices.back()->report.config();
+
+		/* Devices boot at different times */
+		devices.back()->next_reading_ms = std::uniform_int_distribution<uint64_t>{0, options.interval_s * 1000 - 1}(rng);
+	}
+
+	host::NetworkStats previous;
+	uint64_t outage_end_ms = 0;
+	auto real_start = steady_clock::now();
+
+	for (uint64_t now_ms = 0; now_ms < options.duration_s * 1000; now_ms += TICK_MS) {
+		auto tick_start = steady_clock::now();
+
+		if (options.speed > 0) {
+			std::this_thread::sleep_until(real_start
+				+ std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double, std::milli>(now_ms / options.speed)));
+		}
+
+		host::set_clock(now_ms, epoch);
+
+		if (options.outage_every_s != 0 && now_ms % (options.outage_every_s * 1000) == 0 && now_ms > 0) {
+			std::bernoulli_distribution affected{options.outage_fraction};
+
+			for (auto &device : devices) {
+				device->outage = affected(rng);
+			}
+
+			outage_end_ms = now_ms + options.outage_length_s * 1000;
+		} else if (outage_end_ms != 0 && now_ms >= outage_end_ms) {
+			for (auto &device : devices) {
+				device->outage = false;
+			}
+
+			outage_end_ms = 0;
+		}
+
+		for (auto &device : devices) {
+			host::set_network(!device->outage);
+
+			if (now_ms >= device->next_reading_ms) {
+				emulate_sensor(*device, rng);
+				device->next_reading_ms += options.interval_s * 1000;
+			}
+
+			device->report.loop();
+		}
+
+		/*
+		 * Without a speed limit virtual time passes much faster than a real
+		 * server can respond, so requests would time out. Keep virtual time no
+		 * faster than real time while there are requests waiting for a
+		 * response, so that the timeouts are effectively in real time.
+		 */
+		while (options.speed <= 0 && receiving(devices)
+				&& steady_clock::now() - tick_start < std::chrono::milliseconds(TICK_MS)) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+			for (auto &device : devices) {
+				host::set_network(!device->outage);
+				device->report.loop();
+			}
+		}
+
+		if ((now_ms + TICK_MS) % (options.status_s * 1000) == 0) {
+			print_status(now_ms + TICK_MS, devices, host::network_stats(), previous, options.status_s);
+			previous = host::network_stats();
+		}
+	}
+
+	const host::NetworkStats &stats = host::network_stats();
+	double real_s = std::chrono::duration<double>(steady_clock::now() - real_start).count();
+	unsigned long uploads = 0;
+	unsigned long upload_errors = 0;
+	size_t stored = 0;
+	const scd30::Traffic::Usage &http = scd30::Traffic::usage(scd30::TrafficChannel::HTTP);
+
+	for (const auto &device : devices) {
+		uploads += device->report.uploads();
+		upload_errors += device->report.upload_errors();
+		stored += device->report.size();
+	}
+
+	std::printf("\n");
+	std::printf("Devices:            %lu\n", options.devices);
+	std::printf("Duration:           %lus virtual, %.1fs real\n", options.duration_s, real_s);
+	std::printf("Requests:           %lu (%.1f/s virtual, %.1f/s real)\n", stats.requests,
+		stats.requests / static_cast<double>(options.duration_s), stats.requests / real_s);
+	std::printf("Uploads:            %lu (%lu failures)\n", uploads, upload_errors);
+	std::printf("Connections:        %lu (%lu failures)\n", stats.connects, stats.connect_failures);
+	std::printf("Payload bytes:      min %zu, mean %.0f, max %zu\n",
+		stats.requests ? stats.payload_minimum : 0,
+		stats.requests ? static_cast<double>(stats.payload_bytes) / stats.requests : 0.0,
+		stats.payload_maximum);
+	std::printf("Bytes sent:         %llu\n", stats.bytes_sent);
+	std::printf("Bytes received:     %llu\n", stats.bytes_received);
+	std::printf("HTTP sent:          %lu payload, %lu overhead\n",
+		http.sent_payload, http.sent_overhead);
+	std::printf("HTTP received:      %lu payload, %lu overhead\n",
+		http.received_payload, http.received_overhead);
+	std::printf("Readings not sent:  %zu\n", stored);
+
+	return EXIT_SUCCESS;
+}
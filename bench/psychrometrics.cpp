@@ -0,0 +1,86 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "scd30/psychrometrics.h"
+
+using namespace scd30::psychrometrics;
+
+static constexpr int ROUNDS = 50;
+
+template <class T>
+static double time_ns(const std::vector<std::pair<int32_t,int32_t>> &inputs, T &&func) {
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < ROUNDS; i++) {
+		for (const auto &input : inputs) {
+			func(input.first, input.second);
+		}
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / ROUNDS / inputs.size();
+}
+
+int main() {
+	std::vector<std::pair<int32_t,int32_t>> inputs;
+	volatile int32_t sink_i = 0;
+	volatile float sink_f = 0;
+	double dew_point_error = 0;
+	double absolute_humidity_error = 0;
+
+	/* -40.00°C to 80.00°C, 1.00% to 100.00% */
+	for (int32_t temperature_c = -4000; temperature_c <= 8000; temperature_c += 25) {
+		for (int32_t relative_humidity_pc = 100; relative_humidity_pc <= 10000; relative_humidity_pc += 25) {
+			inputs.emplace_back(temperature_c, relative_humidity_pc);
+		}
+	}
+
+	for (const auto &input : inputs) {
+		double temperature_c = input.first / 100.0;
+		double relative_humidity_pc = input.second / 100.0;
+
+		dew_point_error = std::max(dew_point_error, std::fabs(dew_point(input.first, input.second) / 100.0
+			- dew_point_float(temperature_c, relative_humidity_pc)));
+		absolute_humidity_error = std::max(absolute_humidity_error, std::fabs(absolute_humidity(input.first, input.second) / 100.0
+			- absolute_humidity_float(temperature_c, relative_humidity_pc)));
+	}
+
+	printf("Inputs: %zu\n", inputs.size());
+	printf("Maximum error: dew point %.4f°C, absolute humidity %.4f g/m³\n",
+		dew_point_error, absolute_humidity_error);
+
+	printf("Fixed point: %6.1f ns/reading\n", time_ns(inputs, [&] (int32_t t, int32_t rh) {
+		sink_i = dew_point(t, rh);
+		sink_i = absolute_humidity(t, rh);
+	}));
+
+	printf("Float:       %6.1f ns/reading\n", time_ns(inputs, [&] (int32_t t, int32_t rh) {
+		sink_f = dew_point_float(t / 100.0f, rh / 100.0f);
+		sink_f = absolute_humidity_float(t / 100.0f, rh / 100.0f);
+	}));
+
+	printf("(host with an FPU, run \"show derived\" on the device to compare on the target)\n");
+	return 0;
+}
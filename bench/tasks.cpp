@@ -0,0 +1,189 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Overhead of the task engine compared to a hand-written state machine for
+ * the same multi-step transaction (read a register, then write it if the
+ * value is different), and of running many tasks from one pool.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#include "host.h"
+#include "scd30/task.h"
+
+using scd30::TaskFrame;
+using scd30::TaskPool;
+using scd30::TaskStatus;
+
+static constexpr unsigned int TRANSACTIONS = 2000000;
+static constexpr unsigned int POLLS = 4; /* Calls before each response is done */
+
+/* Modbus response that completes after a fixed number of polls */
+struct FakeResponse {
+	unsigned int polls = 0;
+	uint16_t value = 0;
+
+	inline bool done() { return polls == 0 || --polls == 0; }
+};
+
+static FakeResponse request(uint16_t value) {
+	FakeResponse response;
+
+	response.polls = POLLS;
+	response.value = value;
+	return response;
+}
+
+/* Equivalent of the previous Sensor::update_config_register() */
+class StateMachine {
+public:
+	enum class State : uint8_t {
+		NONE,
+		READ,
+		WRITE,
+	};
+
+	bool loop(uint16_t current, uint16_t wanted) {
+		switch (state_) {
+		case State::NONE:
+			response_ = request(current);
+			state_ = State::READ;
+			break;
+
+		case State::READ:
+			if (response_.done()) {
+				if (response_.value == wanted) {
+					state_ = State::NONE;
+					return true;
+				}
+
+				response_ = request(wanted);
+				state_ = State::WRITE;
+			}
+			break;
+
+		case State::WRITE:
+			if (response_.done()) {
+				state_ = State::NONE;
+				return true;
+			}
+			break;
+		}
+
+		return false;
+	}
+
+private:
+	State state_ = State::NONE;
+	FakeResponse response_;
+};
+
+struct Frame: public TaskFrame {
+	FakeResponse response;
+	uint16_t value = 0;
+};
+
+static TaskStatus config_task(Frame &frame, uint16_t current, uint16_t wanted) {
+	TASK_BEGIN(frame);
+	frame.response = request(current);
+	TASK_AWAIT(frame, frame.response.done());
+
+	if (frame.response.value != wanted) {
+		frame.response = request(wanted);
+		TASK_AWAIT(frame, frame.response.done());
+	}
+	TASK_END(frame);
+}
+
+static TaskStatus delay_task(Frame &frame) {
+	TASK_BEGIN(frame);
+	TASK_DELAY(frame, 5);
+	frame.response = request(0);
+	TASK_AWAIT(frame, frame.response.done());
+	TASK_DELAY(frame, 5);
+	TASK_END(frame);
+}
+
+template <class T>
+static double time_ns(unsigned int count, T &&func) {
+	auto start = std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < count; i++) {
+		func(i);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / count;
+}
+
+int main() {
+	volatile unsigned long calls = 0;
+
+	std::printf("Frame size: %zu bytes (TaskFrame %zu bytes)\n", sizeof(Frame), sizeof(TaskFrame));
+	std::printf("Transaction: read, then write when different, %u polls per response\n", POLLS);
+	std::printf("\n");
+
+	StateMachine machine;
+
+	std::printf("State machine: %6.1f ns/transaction\n", time_ns(TRANSACTIONS, [&] (unsigned int i) {
+		while (!machine.loop(i & 1, 1)) {
+			calls = calls + 1;
+		}
+	}));
+
+	Frame frame;
+
+	std::printf("Task:          %6.1f ns/transaction\n", time_ns(TRANSACTIONS, [&] (unsigned int i) {
+		while (config_task(frame, i & 1, 1) == TaskStatus::RUNNING) {
+			calls = calls + 1;
+		}
+	}));
+
+	TaskPool<Frame, 8> pool;
+
+	std::printf("Pool allocate/release: %6.1f ns\n", time_ns(TRANSACTIONS, [&] (unsigned int i __attribute__((unused))) {
+		pool.release(pool.allocate());
+	}));
+
+	/* Tasks waiting on the (virtual) clock, resumed every 1ms */
+	uint64_t uptime_ms = 0;
+	unsigned long started = 0;
+	unsigned long passes = 0;
+
+	host::set_clock(uptime_ms, 0);
+
+	double pass_ns = time_ns(TRANSACTIONS / 8, [&] (unsigned int i __attribute__((unused))) {
+		while (pool.allocate() != nullptr) {
+			started++;
+		}
+
+		pool.run([] (Frame &frame) { return delay_task(frame); });
+		host::set_clock(++uptime_ms, 0);
+		passes++;
+	});
+
+	std::printf("\n");
+	std::printf("Pool of %zu concurrent delay tasks: %6.1f ns per pass, %lu tasks started in %lu passes\n",
+		pool.size(), pass_ns, started, passes);
+
+	return 0;
+}
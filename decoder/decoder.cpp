@@ -0,0 +1,313 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/decoder.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define DECODER_X86
+#endif
+
+#include "scd30/reading.h"
+
+namespace scd30 {
+
+namespace decoder {
+
+/*
+ * Each packed reading is a 32-bit timestamp followed by 48 bits of fields.
+ * Every field is within one of two 32-bit words, A (field bits 0 to 31, at
+ * byte 4) or B (field bits 16 to 47, at byte 6), and is extracted by shifting
+ * it to the top of the word and then back down (arithmetic shift if signed).
+ */
+static constexpr size_t WORD_A_BYTE = sizeof(uint32_t);
+static constexpr size_t WORD_B_BYTE = sizeof(uint32_t) + 2;
+
+struct FieldLayout {
+	bool word_b;
+	int left;
+	int right;
+	bool is_signed;
+};
+
+static constexpr bool field_word_b(size_t index) {
+	return reading_field_offset(index) + READING_FIELDS[index].bits > 32;
+}
+
+static constexpr int field_shift(size_t index) {
+	return field_word_b(index) ? reading_field_offset(index) - 16 : reading_field_offset(index);
+}
+
+static constexpr FieldLayout field_layout(size_t index) {
+	return {
+		field_word_b(index),
+		static_cast<int>(32 - field_shift(index) - READING_FIELDS[index].bits),
+		static_cast<int>(32 - READING_FIELDS[index].bits),
+		READING_FIELDS[index].is_signed,
+	};
+}
+
+static constexpr bool fields_fit(size_t count) {
+	return count == 0 || (fields_fit(count - 1) && field_shift(count - 1) >= 0
+		&& field_shift(count - 1) + READING_FIELDS[count - 1].bits <= 32);
+}
+
+static_assert(Reading::PACKED_BYTES == WORD_B_BYTE + sizeof(uint32_t), "Unexpected size of packed reading");
+static_assert(fields_fit(Reading::FIELDS), "Fields must each be within a 32-bit word");
+
+static constexpr FieldLayout LAYOUT[] = {
+	field_layout(Reading::TEMPERATURE),
+	field_layout(Reading::RELATIVE_HUMIDITY),
+	field_layout(Reading::CO2),
+};
+
+static_assert(sizeof(LAYOUT) / sizeof(LAYOUT[0]) == Reading::FIELDS, "Field layouts do not match fields");
+
+/* Little-endian, compiled to a single load on little-endian hosts */
+static inline uint32_t load32(const uint8_t *data) {
+	return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+		| (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static void decode_scalar(const uint8_t *data, size_t begin, size_t end, uint32_t *timestamp,
+		int32_t *const fields[Reading::FIELDS]) {
+	for (size_t i = begin; i < end; i++) {
+		const uint8_t *record = data + i * Reading::PACKED_BYTES;
+		uint32_t a = load32(record + WORD_A_BYTE);
+		uint32_t b = load32(record + WORD_B_BYTE);
+
+		timestamp[i] = load32(record);
+
+		for (size_t f = 0; f < Reading::FIELDS; f++) {
+			uint32_t word = (LAYOUT[f].word_b ? b : a) << LAYOUT[f].left;
+
+			if (LAYOUT[f].is_signed) {
+				fields[f][i] = static_cast<int32_t>(word) >> LAYOUT[f].right;
+			} else {
+				fields[f][i] = word >> LAYOUT[f].right;
+			}
+		}
+	}
+}
+
+#ifdef DECODER_X86
+/*
+ * Vector loads are 16 bytes from the start of each reading, so the last
+ * readings are decoded by decode_scalar() to avoid reading past the end.
+ */
+static constexpr size_t VECTOR_OVERRUN = (sizeof(__m128i) - 1) / Reading::PACKED_BYTES;
+
+static inline size_t vector_limit(size_t count) {
+	return count > VECTOR_OVERRUN ? count - VECTOR_OVERRUN : 0;
+}
+
+/* Timestamp, word A, word B and zero as 32-bit values */
+#define DECODER_SHUFFLE_RECORD \
+	0, 1, 2, 3, \
+	WORD_A_BYTE, WORD_A_BYTE + 1, WORD_A_BYTE + 2, WORD_A_BYTE + 3, \
+	WORD_B_BYTE, WORD_B_BYTE + 1, WORD_B_BYTE + 2, WORD_B_BYTE + 3, \
+	-1, -1, -1, -1
+
+__attribute__((target("ssse3")))
+static size_t decode_ssse3(const uint8_t *data, size_t count, uint32_t *timestamp,
+		int32_t *const fields[Reading::FIELDS]) {
+	const __m128i shuffle = _mm_setr_epi8(DECODER_SHUFFLE_RECORD);
+	size_t limit = vector_limit(count);
+	size_t i = 0;
+
+	for (; i + 4 <= limit; i += 4) {
+		const uint8_t *record = data + i * Reading::PACKED_BYTES;
+		__m128i r0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(record)), shuffle);
+		__m128i r1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(record + Reading::PACKED_BYTES)), shuffle);
+		__m128i r2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(record + 2 * Reading::PACKED_BYTES)), shuffle);
+		__m128i r3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(record + 3 * Reading::PACKED_BYTES)), shuffle);
+
+		/* Transpose so that each vector has one value from each reading */
+		__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+		__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+		__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+		__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+		__m128i a = _mm_unpackhi_epi64(t0, t1);
+		__m128i b = _mm_unpacklo_epi64(t2, t3);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(&timestamp[i]), _mm_unpacklo_epi64(t0, t1));
+
+		for (size_t f = 0; f < Reading::FIELDS; f++) {
+			__m128i word = _mm_slli_epi32(LAYOUT[f].word_b ? b : a, LAYOUT[f].left);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&fields[f][i]), LAYOUT[f].is_signed
+				? _mm_srai_epi32(word, LAYOUT[f].right) : _mm_srli_epi32(word, LAYOUT[f].right));
+		}
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load_pair(const uint8_t *low, const uint8_t *high, __m256i shuffle) {
+	__m256i pair = _mm256_inserti128_si256(_mm256_castsi128_si256(
+		_mm_loadu_si128(reinterpret_cast<const __m128i *>(low))),
+		_mm_loadu_si128(reinterpret_cast<const __m128i *>(high)), 1);
+
+	return _mm256_shuffle_epi8(pair, shuffle);
+}
+
+__attribute__((target("avx2")))
+static size_t decode_avx2(const uint8_t *data, size_t count, uint32_t *timestamp,
+		int32_t *const fields[Reading::FIELDS]) {
+	const __m256i shuffle = _mm256_setr_epi8(DECODER_SHUFFLE_RECORD, DECODER_SHUFFLE_RECORD);
+	size_t limit = vector_limit(count);
+	size_t i = 0;
+
+	for (; i + 8 <= limit; i += 8) {
+		const uint8_t *record = data + i * Reading::PACKED_BYTES;
+
+		/* Readings 0-3 in the low lanes and 4-7 in the high lanes */
+		__m256i r0 = load_pair(record, record + 4 * Reading::PACKED_BYTES, shuffle);
+		__m256i r1 = load_pair(record + Reading::PACKED_BYTES, record + 5 * Reading::PACKED_BYTES, shuffle);
+		__m256i r2 = load_pair(record + 2 * Reading::PACKED_BYTES, record + 6 * Reading::PACKED_BYTES, shuffle);
+		__m256i r3 = load_pair(record + 3 * Reading::PACKED_BYTES, record + 7 * Reading::PACKED_BYTES, shuffle);
+
+		__m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+		__m256i t1 = _mm256_unpacklo_epi32(r2, r3);
+		__m256i t2 = _mm256_unpackhi_epi32(r0, r1);
+		__m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+		__m256i a = _mm256_unpackhi_epi64(t0, t1);
+		__m256i b = _mm256_unpacklo_epi64(t2, t3);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(&timestamp[i]), _mm256_unpacklo_epi64(t0, t1));
+
+		for (size_t f = 0; f < Reading::FIELDS; f++) {
+			__m256i word = _mm256_slli_epi32(LAYOUT[f].word_b ? b : a, LAYOUT[f].left);
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(&fields[f][i]), LAYOUT[f].is_signed
+				? _mm256_srai_epi32(word, LAYOUT[f].right) : _mm256_srli_epi32(word, LAYOUT[f].right));
+		}
+	}
+
+	return i;
+}
+
+#undef DECODER_SHUFFLE_RECORD
+#endif
+
+std::vector<float> ReadingColumns::values(size_t field) const {
+	const std::vector<int32_t> &column = fields[field];
+	const ReadingField &descriptor = READING_FIELDS[field];
+	std::vector<float> values(column.size());
+
+	for (size_t i = 0; i < column.size(); i++) {
+		values[i] = column[i] == descriptor.nan() ? NAN
+			: column[i] / static_cast<float>(descriptor.div);
+	}
+
+	return values;
+}
+
+bool available(Implementation implementation) {
+	switch (implementation) {
+	case Implementation::SCALAR:
+		return true;
+
+#ifdef DECODER_X86
+	case Implementation::SSSE3:
+		return __builtin_cpu_supports("ssse3");
+
+	case Implementation::AVX2:
+		return __builtin_cpu_supports("avx2");
+#else
+	case Implementation::SSSE3:
+	case Implementation::AVX2:
+		break;
+#endif
+	}
+
+	return false;
+}
+
+const char *name(Implementation implementation) {
+	switch (implementation) {
+	case Implementation::SCALAR:
+		return "scalar";
+
+	case Implementation::SSSE3:
+		return "SSSE3";
+
+	case Implementation::AVX2:
+		return "AVX2";
+	}
+
+	return "?";
+}
+
+Implementation default_implementation() {
+	static const Implementation implementation = available(Implementation::SSSE3)
+		? Implementation::SSSE3 : Implementation::SCALAR;
+
+	return implementation;
+}
+
+void decode(const uint8_t *data, size_t count, uint32_t *timestamp,
+		int32_t *const fields[Reading::FIELDS], Implementation implementation) {
+	size_t decoded = 0;
+
+	switch (implementation) {
+	case Implementation::SCALAR:
+		break;
+
+#ifdef DECODER_X86
+	case Implementation::SSSE3:
+		decoded = decode_ssse3(data, count, timestamp, fields);
+		break;
+
+	case Implementation::AVX2:
+		decoded = decode_avx2(data, count, timestamp, fields);
+		break;
+#else
+	case Implementation::SSSE3:
+	case Implementation::AVX2:
+		break;
+#endif
+	}
+
+	decode_scalar(data, decoded, count, timestamp, fields);
+}
+
+size_t decode(const uint8_t *data, size_t length, ReadingColumns &columns) {
+	size_t count = length / Reading::PACKED_BYTES;
+	size_t offset = columns.size();
+	int32_t *fields[Reading::FIELDS];
+
+	columns.timestamp.resize(offset + count);
+	for (size_t f = 0; f < Reading::FIELDS; f++) {
+		columns.fields[f].resize(offset + count);
+		fields[f] = columns.fields[f].data() + offset;
+	}
+
+	decode(data, count, columns.timestamp.data() + offset, fields);
+	return count;
+}
+
+} // namespace decoder
+
+} // namespace scd30
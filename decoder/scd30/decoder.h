@@ -0,0 +1,83 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Host library for decoding the packed binary readings sent and served by
+ * the device. The layout comes from the same field descriptors as Reading,
+ * so the two can't disagree.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "scd30/reading.h"
+
+namespace scd30 {
+
+namespace decoder {
+
+enum class Implementation : uint8_t {
+	SCALAR,
+	SSSE3, /* 4 readings at a time */
+	AVX2, /* 8 readings at a time */
+};
+
+/* Readings decoded into one array per field */
+struct ReadingColumns {
+	std::vector<uint32_t> timestamp;
+	std::array<std::vector<int32_t>, Reading::FIELDS> fields;
+
+	inline size_t size() const { return timestamp.size(); }
+
+	/* Values of a field in its units (e.g. °C), NaN if not available */
+	std::vector<float> values(size_t field) const;
+};
+
+bool available(Implementation implementation);
+const char *name(Implementation implementation);
+
+/*
+ * Implementation to use on this CPU. Decoding is limited by memory bandwidth,
+ * so this is SSSE3 instead of AVX2 when both are supported because AVX2 was
+ * measured to be no faster (and often slower).
+ */
+Implementation default_implementation();
+
+/*
+ * Decode count packed readings (Reading::PACKED_BYTES each) into arrays of
+ * count values. Fields are fixed point in the units of their descriptors,
+ * with the descriptor's nan() value where they are not available.
+ *
+ * The implementation must be available.
+ */
+void decode(const uint8_t *data, size_t count, uint32_t *timestamp,
+	int32_t *const fields[Reading::FIELDS], Implementation implementation = default_implementation());
+
+/*
+ * Append the complete packed readings in data to the columns. Returns the
+ * number of readings decoded.
+ */
+size_t decode(const uint8_t *data, size_t length, ReadingColumns &columns);
+
+} // namespace decoder
+
+} // namespace scd30
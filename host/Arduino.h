@@ -0,0 +1,138 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Minimal Arduino API for building the firmware's reporting code on a Linux
+ * host. Time is virtual (see host.h) so that many simulated devices can run
+ * in one process, faster than real time.
+ */
+
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <strings.h>
+
+class __FlashStringHelper;
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strncasecmp_P strncasecmp
+#define memcpy_P memcpy
+#define pgm_read_byte(p) (*reinterpret_cast<const uint8_t *>(p))
+
+int snprintf_P(char *str, size_t size, const char *format, ...);
+int vsnprintf_P(char *str, size_t size, const char *format, va_list ap);
+
+unsigned long millis();
+unsigned long micros();
+void yield();
+void delay(unsigned long ms);
+
+class String {
+public:
+	String(const char *str = "") : str_(str ? str : "") {}
+	String(const __FlashStringHelper *str) : str_(reinterpret_cast<const char *>(str)) {}
+	explicit String(unsigned long value) : str_(std::to_string(value)) {}
+	explicit String(unsigned int value) : str_(std::to_string(value)) {}
+	explicit String(long value) : str_(std::to_string(value)) {}
+	explicit String(int value) : str_(std::to_string(value)) {}
+
+	inline bool reserve(size_t size) { str_.reserve(size); return true; }
+	inline size_t length() const { return str_.length(); }
+	inline const char *c_str() const { return str_.c_str(); }
+	inline bool isEmpty() const { return str_.empty(); }
+
+	inline bool concat(const char *str) { str_ += str; return true; }
+	inline bool concat(const char *str, unsigned int length) { str_.append(str, length); return true; }
+	inline bool concat(const __FlashStringHelper *str) { str_ += reinterpret_cast<const char *>(str); return true; }
+	inline bool concat(const String &str) { str_ += str.str_; return true; }
+	inline bool concat(char c) { str_ += c; return true; }
+
+	inline void remove(unsigned int index) { if (index < str_.length()) str_.resize(index); }
+	inline void remove(unsigned int index, unsigned int count) { if (index < str_.length()) str_.erase(index, count); }
+
+	inline bool operator==(const String &other) const { return str_ == other.str_; }
+	inline bool operator==(const char *other) const { return str_ == other; }
+	inline char operator[](unsigned int index) const { return str_[index]; }
+
+private:
+	std::string str_;
+};
+
+class IPAddress {
+public:
+	IPAddress() = default;
+	explicit IPAddress(uint32_t address) : address_(address) {}
+
+	inline operator uint32_t() const { return address_; }
+	String toString() const;
+
+private:
+	uint32_t address_ = 0; /* Network byte order */
+};
+
+class Print {
+public:
+	virtual ~Print() = default;
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size) {
+		size_t n = 0;
+
+		while (size--) {
+			if (!write(*buffer++)) {
+				break;
+			}
+			n++;
+		}
+		return n;
+	}
+};
+
+class Stream: public Print {
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+
+	inline void setTimeout(unsigned long timeout_ms) { timeout_ms_ = timeout_ms; }
+
+protected:
+	unsigned long timeout_ms_ = 1000;
+};
+
+class EspClass {
+public:
+	uint32_t getFreeHeap();
+};
+
+extern EspClass ESP;
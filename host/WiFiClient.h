@@ -0,0 +1,51 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/* Blocking connect and send, non-blocking receive (POSIX sockets) */
+class WiFiClient: public Stream {
+public:
+	WiFiClient() = default;
+	~WiFiClient() override;
+
+	WiFiClient(const WiFiClient&) = delete;
+	WiFiClient& operator=(const WiFiClient&) = delete;
+
+	int connect(const char *host, uint16_t port);
+	uint8_t connected();
+	void stop();
+	void setNoDelay(bool nodelay);
+
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	int available() override;
+	int read() override;
+	int read(uint8_t *buffer, size_t size);
+	int peek() override;
+
+	inline explicit operator bool() { return fd_ != -1; }
+
+private:
+	int fd_ = -1;
+};
@@ -0,0 +1,62 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Non-blocking datagrams (POSIX sockets) */
+class WiFiUDP: public Stream {
+public:
+	WiFiUDP() = default;
+	~WiFiUDP() override;
+
+	WiFiUDP(const WiFiUDP&) = delete;
+	WiFiUDP& operator=(const WiFiUDP&) = delete;
+
+	uint8_t begin(uint16_t port);
+	void stop();
+
+	int beginPacket(const char *host, uint16_t port);
+	int beginPacket(IPAddress address, uint16_t port);
+	int endPacket();
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+
+	int parsePacket();
+	int available() override;
+	int read() override;
+	int read(uint8_t *buffer, size_t size);
+	int peek() override;
+	inline IPAddress remoteIP() const { return remote_address_; }
+	inline uint16_t remotePort() const { return remote_port_; }
+
+private:
+	int fd_ = -1;
+	IPAddress send_address_;
+	uint16_t send_port_ = 0;
+	std::vector<uint8_t> send_buffer_;
+	std::vector<uint8_t> receive_buffer_;
+	size_t receive_pos_ = 0;
+	IPAddress remote_address_;
+	uint16_t remote_port_ = 0;
+};
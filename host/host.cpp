@@ -0,0 +1,500 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "host.h"
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiUdp.h>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <uuid/common.h>
+#include <uuid/log.h>
+
+#include "app/config.h"
+
+EspClass ESP;
+
+namespace host {
+
+static uint64_t uptime_ms_ = 0;
+static time_t epoch_ = 0;
+static uint32_t free_heap_ = 40000;
+static bool network_ = true;
+static int log_level_ = static_cast<int>(uuid::log::Level::ERR);
+static NetworkStats network_stats_;
+
+void set_clock(uint64_t uptime_ms, time_t epoch) {
+	uptime_ms_ = uptime_ms;
+	epoch_ = epoch;
+}
+
+uint64_t uptime_ms() {
+	return uptime_ms_;
+}
+
+time_t epoch() {
+	return epoch_;
+}
+
+void set_free_heap(uint32_t bytes) {
+	free_heap_ = bytes;
+}
+
+void set_network(bool available) {
+	network_ = available;
+}
+
+void set_log_level(int level) {
+	log_level_ = level;
+}
+
+NetworkStats &network_stats() {
+	return network_stats_;
+}
+
+static bool resolve(const char *host, uint16_t port, sockaddr_in &address) {
+	addrinfo hints{};
+	addrinfo *result = nullptr;
+
+	hints.ai_family = AF_INET;
+
+	if (::getaddrinfo(host, nullptr, &hints, &result) != 0 || result == nullptr) {
+		return false;
+	}
+
+	address = *reinterpret_cast<sockaddr_in *>(result->ai_addr);
+	address.sin_port = htons(port);
+	::freeaddrinfo(result);
+	return true;
+}
+
+} // namespace host
+
+/* Flash strings are ordinary strings on the host, so "%S" is the same as "%s" */
+static std::string native_format(const char *format) {
+	std::string text = format;
+
+	for (size_t pos = 0; (pos = text.find("%S", pos)) != std::string::npos; pos += 2) {
+		if (pos == 0 || text[pos - 1] != '%') {
+			text[pos + 1] = 's';
+		}
+	}
+
+	return text;
+}
+
+int snprintf_P(char *str, size_t size, const char *format, ...) {
+	va_list ap;
+
+	va_start(ap, format);
+	int ret = vsnprintf_P(str, size, format, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+int vsnprintf_P(char *str, size_t size, const char *format, va_list ap) {
+	return ::vsnprintf(str, size, native_format(format).c_str(), ap);
+}
+
+unsigned long millis() {
+	/* 32-bit on the device, so that overflow behaves the same way */
+	return static_cast<uint32_t>(host::uptime_ms_);
+}
+
+unsigned long micros() {
+	return static_cast<uint32_t>(host::uptime_ms_ * 1000);
+}
+
+void yield() {
+}
+
+void delay(unsigned long ms) {
+	host::uptime_ms_ += ms;
+}
+
+String IPAddress::toString() const {
+	char text[INET_ADDRSTRLEN];
+	in_addr address{};
+
+	address.s_addr = address_;
+	return String(::inet_ntop(AF_INET, &address, text, sizeof(text)));
+}
+
+uint32_t EspClass::getFreeHeap() {
+	return host::free_heap_;
+}
+
+WiFiClient::~WiFiClient() {
+	stop();
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+	sockaddr_in address;
+
+	stop();
+
+	if (!host::network_ || !host::resolve(host, port, address)) {
+		host::network_stats_.connect_failures++;
+		return 0;
+	}
+
+	fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd_ == -1) {
+		host::network_stats_.connect_failures++;
+		return 0;
+	}
+
+	timeval timeout{};
+
+	timeout.tv_sec = timeout_ms_ / 1000;
+	timeout.tv_usec = (timeout_ms_ % 1000) * 1000;
+	::setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	if (::connect(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+		host::network_stats_.connect_failures++;
+		stop();
+		return 0;
+	}
+
+	host::network_stats_.connects++;
+	return 1;
+}
+
+uint8_t WiFiClient::connected() {
+	if (fd_ == -1 || !host::network_) {
+		return 0;
+	}
+
+	uint8_t c;
+	ssize_t ret = ::recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+	/* Still connected if there's unread data, even when the peer has closed the connection */
+	return ret > 0 || (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+void WiFiClient::stop() {
+	if (fd_ != -1) {
+		::close(fd_);
+		fd_ = -1;
+	}
+}
+
+void WiFiClient::setNoDelay(bool nodelay) {
+	int value = nodelay ? 1 : 0;
+
+	if (fd_ != -1) {
+		::setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+	}
+}
+
+size_t WiFiClient::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+	size_t written = 0;
+
+	if (fd_ == -1 || !host::network_) {
+		return 0;
+	}
+
+	/* Count each request and the size of its body from the header */
+	if (size > 5 && !std::memcmp(buffer, "POST ", 5)) {
+		std::string header{reinterpret_cast<const char *>(buffer), size};
+		size_t pos = header.find("\r\nContent-Length: ");
+
+		host::network_stats_.requests++;
+
+		if (pos != std::string::npos) {
+			size_t length = std::strtoul(header.c_str() + pos + 18, nullptr, 10);
+
+			host::network_stats_.payload_bytes += length;
+			host::network_stats_.payload_minimum = std::min(host::network_stats_.payload_minimum, length);
+			host::network_stats_.payload_maximum = std::max(host::network_stats_.payload_maximum, length);
+		}
+	}
+
+	while (written < size) {
+		ssize_t ret = ::send(fd_, buffer + written, size - written, MSG_NOSIGNAL);
+
+		if (ret <= 0) {
+			if (ret == -1 && errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+
+		written += ret;
+	}
+
+	host::network_stats_.bytes_sent += written;
+	return written;
+}
+
+int WiFiClient::available() {
+	int length = 0;
+
+	if (fd_ == -1 || ::ioctl(fd_, FIONREAD, &length) != 0) {
+		return 0;
+	}
+
+	return length;
+}
+
+int WiFiClient::read() {
+	uint8_t c;
+
+	return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+	if (fd_ == -1) {
+		return -1;
+	}
+
+	ssize_t ret = ::recv(fd_, buffer, size, MSG_DONTWAIT);
+
+	if (ret <= 0) {
+		return -1;
+	}
+
+	host::network_stats_.bytes_received += ret;
+	return ret;
+}
+
+int WiFiClient::peek() {
+	uint8_t c;
+
+	if (fd_ == -1 || ::recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 1) {
+		return -1;
+	}
+
+	return c;
+}
+
+WiFiUDP::~WiFiUDP() {
+	stop();
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+	sockaddr_in address{};
+
+	stop();
+
+	fd_ = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd_ == -1) {
+		return 0;
+	}
+
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (::bind(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+		stop();
+		return 0;
+	}
+
+	return 1;
+}
+
+void WiFiUDP::stop() {
+	if (fd_ != -1) {
+		::close(fd_);
+		fd_ = -1;
+	}
+
+	receive_buffer_.clear();
+	receive_pos_ = 0;
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port) {
+	sockaddr_in address;
+
+	if (!host::resolve(host, port, address)) {
+		return 0;
+	}
+
+	return beginPacket(IPAddress(address.sin_addr.s_addr), port);
+}
+
+int WiFiUDP::beginPacket(IPAddress address, uint16_t port) {
+	send_address_ = address;
+	send_port_ = port;
+	send_buffer_.clear();
+	return 1;
+}
+
+int WiFiUDP::endPacket() {
+	sockaddr_in address{};
+
+	if (fd_ == -1 || !host::network_) {
+		return 0;
+	}
+
+	address.sin_family = AF_INET;
+	address.sin_port = htons(send_port_);
+	address.sin_addr.s_addr = send_address_;
+
+	ssize_t ret = ::sendto(fd_, send_buffer_.data(), send_buffer_.size(), 0,
+		reinterpret_cast<sockaddr *>(&address), sizeof(address));
+
+	if (ret != static_cast<ssize_t>(send_buffer_.size())) {
+		return 0;
+	}
+
+	host::network_stats_.bytes_sent += ret;
+	return 1;
+}
+
+size_t WiFiUDP::write(uint8_t c) {
+	send_buffer_.push_back(c);
+	return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+	send_buffer_.insert(send_buffer_.end(), buffer, buffer + size);
+	return size;
+}
+
+int WiFiUDP::parsePacket() {
+	sockaddr_in address{};
+	socklen_t address_length = sizeof(address);
+	uint8_t buffer[1500];
+
+	receive_buffer_.clear();
+	receive_pos_ = 0;
+
+	if (fd_ == -1 || !host::network_) {
+		return 0;
+	}
+
+	ssize_t ret = ::recvfrom(fd_, buffer, sizeof(buffer), 0,
+		reinterpret_cast<sockaddr *>(&address), &address_length);
+
+	if (ret <= 0) {
+		return 0;
+	}
+
+	host::network_stats_.bytes_received += ret;
+	receive_buffer_.assign(buffer, buffer + ret);
+	remote_address_ = IPAddress(address.sin_addr.s_addr);
+	remote_port_ = ntohs(address.sin_port);
+	return ret;
+}
+
+int WiFiUDP::available() {
+	return receive_buffer_.size() - receive_pos_;
+}
+
+int WiFiUDP::read() {
+	return receive_pos_ < receive_buffer_.size() ? receive_buffer_[receive_pos_++] : -1;
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t size) {
+	size = std::min(size, receive_buffer_.size() - receive_pos_);
+
+	std::memcpy(buffer, receive_buffer_.data() + receive_pos_, size);
+	receive_pos_ += size;
+	return size;
+}
+
+int WiFiUDP::peek() {
+	return receive_pos_ < receive_buffer_.size() ? receive_buffer_[receive_pos_] : -1;
+}
+
+namespace uuid {
+
+std::string read_flash_string(const __FlashStringHelper *flash_str) {
+	return reinterpret_cast<const char *>(flash_str);
+}
+
+uint64_t get_uptime_ms() {
+	return host::uptime_ms_;
+}
+
+namespace log {
+
+#define LOGGER_LEVEL(name, level) \
+	void Logger::name(const __FlashStringHelper *format, ...) const { \
+		va_list ap; \
+		va_start(ap, format); \
+		vlog(Level::level, format, ap); \
+		va_end(ap); \
+	}
+
+LOGGER_LEVEL(emerg, EMERG)
+LOGGER_LEVEL(alert, ALERT)
+LOGGER_LEVEL(crit, CRIT)
+LOGGER_LEVEL(err, ERR)
+LOGGER_LEVEL(warning, WARNING)
+LOGGER_LEVEL(notice, NOTICE)
+LOGGER_LEVEL(info, INFO)
+LOGGER_LEVEL(debug, DEBUG)
+LOGGER_LEVEL(trace, TRACE)
+
+Level Logger::level() {
+	return static_cast<Level>(host::log_level_);
+}
+
+void Logger::vlog(Level level, const __FlashStringHelper *format, va_list ap) const {
+	if (static_cast<int>(level) > host::log_level_) {
+		return;
+	}
+
+	std::fprintf(stderr, "%10.3f %s: ", host::uptime_ms_ / 1000.0, reinterpret_cast<const char *>(name_));
+	std::vfprintf(stderr, native_format(reinterpret_cast<const char *>(format)).c_str(), ap);
+	std::fputc('\n', stderr);
+}
+
+} // namespace log
+
+} // namespace uuid
+
+namespace app {
+
+#define MCU_APP_CONFIG_PRIMITIVE(__type, __key_prefix, __name, __key_suffix, __default) \
+	__type Config::__name##_ = __default; \
+	__type Config::__name() const { return __name##_; } \
+	void Config::__name(__type __name) { __name##_ = __name; }
+
+#define MCU_APP_CONFIG_SIMPLE(__type, __key_prefix, __name, __key_suffix, __default) \
+	__type Config::__name##_ = __default; \
+	__type Config::__name() const { return __name##_; } \
+	void Config::__name(const __type &__name) { __name##_ = __name; }
+
+MCU_APP_CONFIG_DATA
+
+} // namespace app
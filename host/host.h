@@ -0,0 +1,57 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <time.h>
+
+/* Control of the simulated environment used by host builds */
+namespace host {
+
+/* Traffic through all WiFiClient instances */
+struct NetworkStats {
+	unsigned long connects = 0;
+	unsigned long connect_failures = 0;
+	unsigned long requests = 0;
+	unsigned long long bytes_sent = 0;
+	unsigned long long bytes_received = 0;
+	unsigned long long payload_bytes = 0; /* Request bodies (Content-Length) */
+	size_t payload_minimum = SIZE_MAX;
+	size_t payload_maximum = 0;
+};
+
+/* Virtual clock, millis() and time() are derived from these */
+void set_clock(uint64_t uptime_ms, time_t epoch);
+uint64_t uptime_ms();
+time_t epoch();
+
+/* Used to size the reading store when the capacity is automatic */
+void set_free_heap(uint32_t bytes);
+
+/* When false, all connections fail (simulated network outage) */
+void set_network(bool available);
+
+/* Minimum level of log messages to print, from uuid::log::Level */
+void set_log_level(int level);
+
+NetworkStats &network_stats();
+
+} // namespace host
@@ -0,0 +1,43 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replaces the C library's time() so that code calling ::time() uses the
+ * virtual clock. This file must not include <time.h>.
+ */
+
+#include <sys/types.h>
+
+#include <cstdint>
+
+namespace host {
+
+uint64_t uptime_ms();
+time_t epoch();
+
+} // namespace host
+
+extern "C" time_t time(time_t *t) {
+	time_t now = host::epoch() + host::uptime_ms() / 1000;
+
+	if (t != nullptr) {
+		*t = now;
+	}
+
+	return now;
+}
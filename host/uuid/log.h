@@ -0,0 +1,77 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstdint>
+
+#include <uuid/common.h>
+
+namespace uuid {
+
+namespace log {
+
+enum class Level : int8_t {
+	OFF = -1,
+	EMERG = 0,
+	ALERT,
+	CRIT,
+	ERR,
+	WARNING,
+	NOTICE,
+	INFO,
+	DEBUG,
+	TRACE,
+	ALL,
+};
+
+enum class Facility : uint8_t {
+	KERN = 0,
+	USER,
+	MAIL,
+	DAEMON,
+};
+
+/* Prints to stderr, "%S" is treated as "%s" (flash strings are ordinary strings) */
+class Logger {
+public:
+	Logger(const __FlashStringHelper *name, Facility facility __attribute__((unused))) : name_(name) {}
+
+	void emerg(const __FlashStringHelper *format, ...) const;
+	void alert(const __FlashStringHelper *format, ...) const;
+	void crit(const __FlashStringHelper *format, ...) const;
+	void err(const __FlashStringHelper *format, ...) const;
+	void warning(const __FlashStringHelper *format, ...) const;
+	void notice(const __FlashStringHelper *format, ...) const;
+	void info(const __FlashStringHelper *format, ...) const;
+	void debug(const __FlashStringHelper *format, ...) const;
+	void trace(const __FlashStringHelper *format, ...) const;
+
+	static Level level();
+
+private:
+	void vlog(Level level, const __FlashStringHelper *format, va_list ap) const;
+
+	const __FlashStringHelper *name_;
+};
+
+} // namespace log
+
+} // namespace uuid
@@ -1,6 +1,6 @@
 /*
  * scd30 - SCD30 Monitor
- * Copyright 2022  Simon Arlott
+ * Copyright 2022,2026  Simon Arlott
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,6 +18,14 @@
 
 #include "scd30/app.h"
 
+#include <Arduino.h>
+#ifdef ARDUINO_ARCH_ESP8266
+# include <ESP8266WiFi.h>
+#else
+# include <WiFi.h>
+#endif
+#include <time.h>
+
 #include <initializer_list>
 #include <memory>
 #include <vector>
@@ -32,17 +40,22 @@
 #include "app/config.h"
 #include "app/console.h"
 #include "app/network.h"
+#include "scd30/boot.h"
+#include "scd30/counters.h"
 #include "scd30/report.h"
 #include "scd30/sensor.h"
 
 namespace scd30 {
 
-App::App() : sensor_(App::serial_modbus_, App::SENSOR_PIN, report_) {
+App::App() : sensor_(App::serial_modbus_, App::SENSOR_PIN, report_), gateway_(report_), history_server_(report_) {
 
 }
 
 void App::start() {
+	BootTiming::mark(BootPhase::START);
+
 	app::App::start();
+	Counters::start();
 
 	if (!local_console_enabled()) {
 		serial_modbus_.begin(SERIAL_MODBUS_BAUD_RATE, SERIAL_8N1);
@@ -51,15 +64,44 @@ void App::start() {
 	}
 
 	config_report();
+	config_modbus();
+	config_gateway();
+	config_history();
 }
 
 void App::loop() {
+	uint32_t start_us = ::micros();
+
 	app::App::loop();
 
+	if (!BootTiming::reached(BootPhase::NETWORK)) {
+		if (WiFi.status() == WL_CONNECTED) {
+			BootTiming::mark(BootPhase::NETWORK);
+		}
+	}
+
+	if (!BootTiming::reached(BootPhase::TIME)) {
+		if (::time(nullptr) >= Report::MINIMUM_TIMESTAMP) {
+			BootTiming::mark(BootPhase::TIME);
+		}
+	}
+
 	if (!local_console_enabled()) {
 		sensor_.loop();
+		gateway_.loop();
 		report_.loop();
+
+		if (sensor_.last_reading_s() != modbus_reading_s_) {
+			modbus_server_.update(sensor_, report_);
+			modbus_reading_s_ = sensor_.last_reading_s();
+		}
 	}
+
+	modbus_server_.loop();
+	history_server_.loop();
+
+	Counters::loop_time(::micros() - start_us);
+	Counters::loop();
 }
 
 void App::config_sensor(std::initializer_list<Operation> operations) {
@@ -74,4 +116,16 @@ void App::config_report() {
 	report_.config();
 }
 
+void App::config_modbus() {
+	modbus_server_.config();
+}
+
+void App::config_gateway() {
+	gateway_.config();
+}
+
+void App::config_history() {
+	history_server_.config();
+}
+
 } // namespace scd30
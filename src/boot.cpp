@@ -0,0 +1,111 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/boot.h"
+
+#include <Arduino.h>
+
+#include <bitset>
+#include <vector>
+
+#include <uuid/log.h>
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(sizeof(int)))) PROGMEM = "boot";
+
+namespace scd30 {
+
+uuid::log::Logger BootTiming::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+std::bitset<BootTiming::PHASES> BootTiming::reached_;
+uint32_t BootTiming::time_ms_[BootTiming::PHASES];
+
+void BootTiming::mark(BootPhase phase) {
+	size_t index = static_cast<size_t>(phase);
+
+	if (reached_[index]) {
+		return;
+	}
+
+	time_ms_[index] = ::millis();
+	reached_.set(index);
+	logger_.debug(F("Reached %S at %lums"), name(phase), static_cast<unsigned long>(time_ms_[index]));
+
+	if (phase == BootPhase::FIRST_UPLOAD) {
+		log_summary();
+	}
+}
+
+const __FlashStringHelper *BootTiming::name(BootPhase phase) {
+	switch (phase) {
+	case BootPhase::START:
+		return F("start");
+
+	case BootPhase::NETWORK:
+		return F("network");
+
+	case BootPhase::TIME:
+		return F("time");
+
+	case BootPhase::SENSOR_FIRMWARE:
+		return F("firmware");
+
+	case BootPhase::SENSOR_CONFIG:
+		return F("config");
+
+	case BootPhase::FIRST_READING:
+		return F("reading");
+
+	case BootPhase::CA_CERTS:
+		return F("certs");
+
+	case BootPhase::TLS_HANDSHAKE:
+		return F("tls");
+
+	case BootPhase::FIRST_UPLOAD:
+		return F("upload");
+	}
+
+	return F("?");
+}
+
+void BootTiming::log_summary() {
+	std::vector<char> text(PHASES * 24 + 1);
+	size_t pos = 0;
+
+	for (size_t i = 0; i < PHASES; i++) {
+		BootPhase phase = static_cast<BootPhase>(i);
+		int len;
+
+		if (reached_[i]) {
+			len = snprintf_P(&text[pos], text.size() - pos, PSTR("%s%S=%lums"),
+				pos ? " " : "", name(phase), static_cast<unsigned long>(time_ms_[i]));
+		} else {
+			len = snprintf_P(&text[pos], text.size() - pos, PSTR("%s%S=-"),
+				pos ? " " : "", name(phase));
+		}
+
+		if (len < 0 || pos + len >= text.size()) {
+			break;
+		}
+
+		pos += len;
+	}
+
+	logger_.notice(F("Boot summary: %s"), text.data());
+}
+
+} // namespace scd30
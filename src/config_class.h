@@ -1,6 +1,6 @@
 /*
  * scd30 - SCD30 Monitor
- * Copyright 2022  Simon Arlott
+ * Copyright 2022,2026  Simon Arlott
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -23,12 +23,30 @@
 	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", sensor_measurement_interval, "", 2) \
 	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", sensor_ambient_pressure, "", 0) \
 	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", take_measurement_interval, "", 5) \
+	MCU_APP_CONFIG_PRIMITIVE(bool, "", take_measurement_align, "", true) \
+	MCU_APP_CONFIG_PRIMITIVE(bool, "", take_measurement_adaptive, "", false) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", take_measurement_minimum_interval, "", 2) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", take_measurement_maximum_interval, "", 60) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", take_measurement_rate, "", 30) \
 	MCU_APP_CONFIG_PRIMITIVE(bool, "", report_enabled, "", true) \
 	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", report_threshold, "", 12) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", report_max_latency, "", 0) \
+	MCU_APP_CONFIG_PRIMITIVE(bool, "", report_derived, "", false) \
+	MCU_APP_CONFIG_PRIMITIVE(bool, "", report_quantiles, "", false) \
+	MCU_APP_CONFIG_PRIMITIVE(bool, "", report_latency, "", false) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", report_backfill_batch, "", 0) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", report_aggregate, "", 0) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", report_pipeline, "", 1) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", report_capacity, "", 0) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", report_memory, "", 25) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", modbus_port, "", 0) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", gateway_port, "", 0) \
+	MCU_APP_CONFIG_PRIMITIVE(unsigned long, "", history_port, "", 0) \
 	MCU_APP_CONFIG_SIMPLE(std::string, "", report_url, "", "") \
 	MCU_APP_CONFIG_SIMPLE(std::string, "", report_username, "", "") \
 	MCU_APP_CONFIG_SIMPLE(std::string, "", report_password, "", "") \
-	MCU_APP_CONFIG_SIMPLE(std::string, "", report_sensor_name, "", "")
+	MCU_APP_CONFIG_SIMPLE(std::string, "", report_sensor_name, "", "") \
+	MCU_APP_CONFIG_SIMPLE(std::string, "", report_gateway, "", "")
 
 public:
 	bool sensor_automatic_calibration() const;
@@ -49,12 +67,63 @@ public:
 	unsigned long take_measurement_interval() const;
 	void take_measurement_interval(unsigned long take_measurement_interval);
 
+	bool take_measurement_align() const;
+	void take_measurement_align(bool take_measurement_align);
+
+	bool take_measurement_adaptive() const;
+	void take_measurement_adaptive(bool take_measurement_adaptive);
+
+	unsigned long take_measurement_minimum_interval() const;
+	void take_measurement_minimum_interval(unsigned long take_measurement_minimum_interval);
+
+	unsigned long take_measurement_maximum_interval() const;
+	void take_measurement_maximum_interval(unsigned long take_measurement_maximum_interval);
+
+	unsigned long take_measurement_rate() const;
+	void take_measurement_rate(unsigned long take_measurement_rate);
+
 	bool report_enabled() const;
 	void report_enabled(bool report_enabled);
 
 	unsigned long report_threshold() const;
 	void report_threshold(unsigned long report_threshold);
 
+	unsigned long report_max_latency() const;
+	void report_max_latency(unsigned long report_max_latency);
+
+	bool report_derived() const;
+	void report_derived(bool report_derived);
+
+	bool report_quantiles() const;
+	void report_quantiles(bool report_quantiles);
+
+	bool report_latency() const;
+	void report_latency(bool report_latency);
+
+	unsigned long report_backfill_batch() const;
+	void report_backfill_batch(unsigned long report_backfill_batch);
+
+	unsigned long report_aggregate() const;
+	void report_aggregate(unsigned long report_aggregate);
+
+	unsigned long report_pipeline() const;
+	void report_pipeline(unsigned long report_pipeline);
+
+	unsigned long report_capacity() const;
+	void report_capacity(unsigned long report_capacity);
+
+	unsigned long report_memory() const;
+	void report_memory(unsigned long report_memory);
+
+	unsigned long modbus_port() const;
+	void modbus_port(unsigned long modbus_port);
+
+	unsigned long gateway_port() const;
+	void gateway_port(unsigned long gateway_port);
+
+	unsigned long history_port() const;
+	void history_port(unsigned long history_port);
+
 	std::string report_url() const;
 	void report_url(const std::string &report_url);
 
@@ -67,6 +136,9 @@ public:
 	std::string report_sensor_name() const;
 	void report_sensor_name(const std::string &report_sensor_name);
 
+	std::string report_gateway() const;
+	void report_gateway(const std::string &report_gateway);
+
 private:
 	static bool sensor_automatic_calibration_;
 	static unsigned long sensor_temperature_offset_;
@@ -74,9 +146,27 @@ private:
 	static unsigned long sensor_measurement_interval_;
 	static unsigned long sensor_ambient_pressure_;
 	static unsigned long take_measurement_interval_;
+	static bool take_measurement_align_;
+	static bool take_measurement_adaptive_;
+	static unsigned long take_measurement_minimum_interval_;
+	static unsigned long take_measurement_maximum_interval_;
+	static unsigned long take_measurement_rate_;
 	static bool report_enabled_;
 	static unsigned long report_threshold_;
+	static unsigned long report_max_latency_;
+	static bool report_derived_;
+	static bool report_quantiles_;
+	static bool report_latency_;
+	static unsigned long report_backfill_batch_;
+	static unsigned long report_aggregate_;
+	static unsigned long report_pipeline_;
+	static unsigned long report_capacity_;
+	static unsigned long report_memory_;
+	static unsigned long modbus_port_;
+	static unsigned long gateway_port_;
+	static unsigned long history_port_;
 	static std::string report_url_;
 	static std::string report_username_;
 	static std::string report_password_;
 	static std::string report_sensor_name_;
+	static std::string report_gateway_;
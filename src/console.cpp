@@ -1,6 +1,6 @@
 /*
  * scd30 - SCD30 Monitor
- * Copyright 2022,2024  Simon Arlott
+ * Copyright 2022,2024,2026  Simon Arlott
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -27,6 +27,10 @@
 #include <uuid/log.h>
 
 #include "scd30/app.h"
+#include "scd30/boot.h"
+#include "scd30/counters.h"
+#include "scd30/psychrometrics.h"
+#include "scd30/traffic.h"
 #include "app/config.h"
 #include "app/console.h"
 
@@ -49,18 +53,38 @@ namespace scd30 {
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic error "-Wunused-const-variable"
+MAKE_PSTR_WORD(adaptive)
+MAKE_PSTR_WORD(aggregate)
+MAKE_PSTR_WORD(align)
 MAKE_PSTR_WORD(altitude)
 MAKE_PSTR_WORD(ambient)
+MAKE_PSTR_WORD(backfill)
+MAKE_PSTR_WORD(boot)
 MAKE_PSTR_WORD(calibrate)
+MAKE_PSTR_WORD(capacity)
 MAKE_PSTR_WORD(compensation)
+MAKE_PSTR_WORD(counters)
+MAKE_PSTR_WORD(derived)
+MAKE_PSTR_WORD(gateway)
+MAKE_PSTR_WORD(history)
 MAKE_PSTR_WORD(interval)
+MAKE_PSTR_WORD(latency)
+MAKE_PSTR(max_latency, "max-latency")
+MAKE_PSTR_WORD(maximum)
 MAKE_PSTR_WORD(measurement)
+MAKE_PSTR_WORD(memory)
+MAKE_PSTR_WORD(minimum)
+MAKE_PSTR_WORD(modbus)
 MAKE_PSTR_WORD(name)
 MAKE_PSTR_WORD(off)
 MAKE_PSTR_WORD(offset)
 MAKE_PSTR_WORD(on)
 MAKE_PSTR_WORD(password)
+MAKE_PSTR_WORD(pipeline)
+MAKE_PSTR_WORD(port)
 MAKE_PSTR_WORD(pressure)
+MAKE_PSTR_WORD(quantiles)
+MAKE_PSTR_WORD(rate)
 MAKE_PSTR_WORD(reading)
 MAKE_PSTR_WORD(report)
 MAKE_PSTR_WORD(sensor)
@@ -68,18 +92,24 @@ MAKE_PSTR_WORD(set)
 MAKE_PSTR_WORD(show)
 MAKE_PSTR_WORD(temperature)
 MAKE_PSTR_WORD(threshold)
+MAKE_PSTR_WORD(traffic)
 MAKE_PSTR_WORD(username)
 MAKE_PSTR_WORD(url)
 MAKE_PSTR(altitude_optional, "[altitude above sea level in m]")
 MAKE_PSTR(count_optional, "[count]")
+MAKE_PSTR(host_optional, "[host[:port]]")
 MAKE_PSTR(name_optional, "[name]")
 MAKE_PSTR(new_password_prompt1, "Enter new password: ")
 MAKE_PSTR(new_password_prompt2, "Retype new password: ")
 MAKE_PSTR(ppm_mandatory, "<CO₂ concentration in ppm>")
+MAKE_PSTR(ppm_per_minute_optional, "[CO₂ ppm per minute]")
+MAKE_PSTR(port_optional, "[port]")
+MAKE_PSTR(percent_optional, "[percent of free memory]")
 MAKE_PSTR(pressure_optional, "[pressure in mbar]")
 MAKE_PSTR(seconds_optional, "[seconds]")
 MAKE_PSTR(temperature_optional, "[temperature in °C]")
 MAKE_PSTR(url_optional, "[url]")
+MAKE_PSTR(url_secondary_optional, "[secondary url]")
 #pragma GCC diagnostic pop
 
 static constexpr inline AppShell &to_app_shell(Shell &shell) {
@@ -93,6 +123,107 @@ static constexpr inline App &to_app(Shell &shell) {
 static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 	#define NO_ARGUMENTS std::vector<std::string>{}
 
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(gateway), F_(port)},
+			flash_string_vector{F_(port_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value > UINT16_MAX) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.gateway_port(value);
+			config.commit();
+			to_app(shell).config_gateway();
+		}
+
+		if (config.gateway_port() != 0) {
+			shell.printfln(F("Gateway port = %lu"), config.gateway_port());
+		} else {
+			shell.println(F("Gateway disabled"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(history), F_(port)},
+			flash_string_vector{F_(port_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value > UINT16_MAX) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.history_port(value);
+			config.commit();
+			to_app(shell).config_history();
+		}
+
+		if (config.history_port() != 0) {
+			shell.printfln(F("History server port = %lu"), config.history_port());
+		} else {
+			shell.println(F("History server disabled"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(modbus), F_(port)},
+			flash_string_vector{F_(port_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value > UINT16_MAX) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.modbus_port(value);
+			config.commit();
+			to_app(shell).config_modbus();
+		}
+
+		if (config.modbus_port() != 0) {
+			shell.printfln(F("Modbus TCP port = %lu"), config.modbus_port());
+		} else {
+			shell.println(F("Modbus TCP server disabled"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(gateway)},
+			flash_string_vector{F_(host_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			config.report_gateway(arguments[0]);
+			config.commit();
+			to_app(shell).config_report();
+		}
+
+		if (!config.report_gateway().empty()) {
+			shell.printfln(F("Report gateway = %s"), config.report_gateway().c_str());
+		} else {
+			shell.println(F("Report gateway disabled"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(gateway), F_(off)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.report_gateway("");
+		config.commit();
+		to_app(shell).config_report();
+		shell.println(F("Report gateway disabled"));
+	});
+
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(sensor), F_(name)},
 			flash_string_vector{F_(name_optional)},
 			[=] (Shell &shell, const std::vector<std::string> &arguments) {
@@ -123,6 +254,203 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 		shell.println(F("Reporting disabled"));
 	});
 
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(aggregate)},
+			flash_string_vector{F_(seconds_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value > UINT16_MAX) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.report_aggregate(value);
+			config.commit();
+			to_app(shell).config_report();
+		}
+
+		if (config.report_aggregate() != 0) {
+			shell.printfln(F("Report aggregate = %lus"), config.report_aggregate());
+		} else {
+			shell.println(F("Report aggregate = disabled"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(backfill)},
+			flash_string_vector{F_(count_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.report_backfill_batch(value);
+			config.commit();
+			to_app(shell).config_report();
+		}
+
+		if (config.report_backfill_batch() != 0) {
+			shell.printfln(F("Report backfill batch = %lu"), config.report_backfill_batch());
+		} else {
+			shell.println(F("Report backfill batch = unlimited"));
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(derived), F_(on)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.report_derived(true);
+		config.commit();
+		to_app(shell).config_report();
+		shell.println(F("Reporting of derived values enabled"));
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(derived), F_(off)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.report_derived(false);
+		config.commit();
+		to_app(shell).config_report();
+		shell.println(F("Reporting of derived values disabled"));
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(latency), F_(on)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.report_latency(true);
+		config.commit();
+		to_app(shell).config_report();
+		shell.println(F("Reporting of latency percentiles enabled"));
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(latency), F_(off)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.report_latency(false);
+		config.commit();
+		to_app(shell).config_report();
+		shell.println(F("Reporting of latency percentiles disabled"));
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(quantiles), F_(on)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.report_quantiles(true);
+		config.commit();
+		to_app(shell).config_report();
+		shell.println(F("Reporting of aggregate quantiles enabled"));
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(quantiles), F_(off)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.report_quantiles(false);
+		config.commit();
+		to_app(shell).config_report();
+		shell.println(F("Reporting of aggregate quantiles disabled"));
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(capacity)},
+			flash_string_vector{F_(count_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || (value != 0 && (value < Report::MINIMUM_STORE_READINGS
+					|| value > Report::MAXIMUM_STORE_READINGS))) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.report_capacity(value);
+			config.commit();
+			to_app(shell).config_report();
+		}
+
+		if (config.report_capacity() != 0) {
+			shell.printfln(F("Report capacity = %lu"), config.report_capacity());
+		} else {
+			shell.printfln(F("Report capacity = automatic (%lu%% of free memory)"), config.report_memory());
+		}
+
+		shell.printfln(F("Stored readings: %u/%u"), to_app(shell).report().size(), to_app(shell).report().capacity());
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(memory)},
+			flash_string_vector{F_(percent_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value < 1 || value > Report::MAXIMUM_STORE_MEMORY_PC) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.report_memory(value);
+			config.commit();
+			to_app(shell).config_report();
+		}
+		shell.printfln(F("Report memory = %lu%%"), config.report_memory());
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(pipeline)},
+			flash_string_vector{F_(count_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value < 1 || value > Report::MAXIMUM_PIPELINE) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.report_pipeline(value);
+			config.commit();
+			to_app(shell).config_report();
+		}
+		shell.printfln(F("Report pipeline = %lu"), config.report_pipeline());
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(max_latency)},
+			flash_string_vector{F_(seconds_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.report_max_latency(value);
+			config.commit();
+			to_app(shell).config_report();
+		}
+
+		if (config.report_max_latency() != 0) {
+			shell.printfln(F("Report max latency = %lus"), config.report_max_latency());
+		} else {
+			shell.println(F("Report max latency = disabled"));
+		}
+	});
+
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(threshold)},
 			flash_string_vector{F_(count_optional)},
 			[=] (Shell &shell, const std::vector<std::string> &arguments) {
@@ -156,11 +484,20 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 	});
 
 	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(report), F_(url)},
-			flash_string_vector{F_(url_optional)},
+			flash_string_vector{F_(url_optional), F_(url_secondary_optional), F_(url_secondary_optional)},
 			[=] (Shell &shell, const std::vector<std::string> &arguments) {
 		Config config;
 		if (!arguments.empty()) {
-			config.report_url(arguments.front());
+			std::string urls;
+
+			for (const auto &url : arguments) {
+				if (!urls.empty()) {
+					urls += ' ';
+				}
+				urls += url;
+			}
+
+			config.report_url(urls);
 			config.commit();
 			to_app(shell).config_report();
 		}
@@ -228,6 +565,24 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 		}
 	};
 
+	auto sensor_reading_adaptive = [] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+
+		if (config.take_measurement_adaptive()) {
+			shell.printfln(F("Adaptive reading interval: %lus to %lus, above %lu ppm/min (currently %us)"),
+				config.take_measurement_minimum_interval(), config.take_measurement_maximum_interval(),
+				config.take_measurement_rate(), to_app(shell).sensor().reading_interval_s());
+		} else {
+			shell.println(F("Adaptive reading interval: disabled"));
+		}
+	};
+
+	auto sensor_reading_align = [] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+
+		shell.printfln(F("Reading alignment: %S"), config.take_measurement_align() ? F("enabled") : F("disabled"));
+	};
+
 	auto sensor_temperature_offset = [] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
 		Config config;
 		unsigned long value = config.sensor_temperature_offset();
@@ -235,6 +590,200 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 		shell.printfln(F("Temperature offset: %lu.%02lu°C"), value / 100, value % 100);
 	};
 
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(boot)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		for (size_t i = 0; i < BootTiming::PHASES; i++) {
+			BootPhase phase = static_cast<BootPhase>(i);
+
+			if (BootTiming::reached(phase)) {
+				shell.printfln(F("%-8S %8lums"), BootTiming::name(phase),
+					static_cast<unsigned long>(BootTiming::time_ms(phase)));
+			} else {
+				shell.printfln(F("%-8S        -"), BootTiming::name(phase));
+			}
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(counters)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		shell.println(F("                       Boot    Lifetime"));
+
+		for (size_t i = 0; i < Counters::COUNTERS; i++) {
+			Counter counter = static_cast<Counter>(i);
+
+			shell.printfln(F("%-16S %10lu  %10lu"), Counters::name(counter),
+				static_cast<unsigned long>(Counters::boot(counter)),
+				static_cast<unsigned long>(Counters::lifetime(counter)));
+		}
+
+		shell.printfln(F("%-16S %8luµs  %8luµs"), F("Max loop time"),
+			static_cast<unsigned long>(Counters::boot_max_loop_us()),
+			static_cast<unsigned long>(Counters::lifetime_max_loop_us()));
+
+		shell.println();
+		shell.printfln(F("Reset cause: %S"), Counters::name(Counters::reset_cause()));
+
+		for (size_t i = 0; i < Counters::RESET_CAUSES; i++) {
+			ResetCause cause = static_cast<ResetCause>(i);
+
+			if (Counters::resets(cause) != 0) {
+				shell.printfln(F("  %-14S %10lu"), Counters::name(cause),
+					static_cast<unsigned long>(Counters::resets(cause)));
+			}
+		}
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(traffic)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		auto print_table = [&shell] (bool hourly) {
+			shell.println(F("                            Sent bytes       Received bytes"));
+			shell.println(F("Channel            Count  Payload Overhead  Payload Overhead"));
+
+			for (size_t i = 0; i < Traffic::CHANNELS; i++) {
+				TrafficChannel channel = static_cast<TrafficChannel>(i);
+				const Traffic::Usage &usage = Traffic::usage(channel);
+				auto value = [hourly] (unsigned long total) {
+					return hourly ? Traffic::hourly(total) : total;
+				};
+
+				shell.printfln(F("%-18S %6lu %8lu %8lu %8lu %8lu"), Traffic::name(channel),
+					value(usage.count), value(usage.sent_payload), value(usage.sent_overhead),
+					value(usage.received_payload), value(usage.received_overhead));
+			}
+		};
+
+		shell.println(F("Since boot:"));
+		print_table(false);
+		shell.println();
+		shell.println(F("Per hour:"));
+		print_table(true);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(derived)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		/* Time the fixed point and float versions on this device, -40°C to 80°C and 1% to 100% */
+		unsigned long count = 0;
+		volatile int32_t sink_i = 0;
+		volatile float sink_f = 0;
+		unsigned long start_us = ::micros();
+
+		for (int32_t temperature_c = -4000; temperature_c <= 8000; temperature_c += 500) {
+			for (int32_t relative_humidity_pc = 100; relative_humidity_pc <= 10000; relative_humidity_pc += 500) {
+				sink_i = psychrometrics::dew_point(temperature_c, relative_humidity_pc);
+				sink_i = psychrometrics::absolute_humidity(temperature_c, relative_humidity_pc);
+				count++;
+			}
+		}
+
+		unsigned long fixed_us = ::micros() - start_us;
+
+		start_us = ::micros();
+
+		for (int32_t temperature_c = -4000; temperature_c <= 8000; temperature_c += 500) {
+			for (int32_t relative_humidity_pc = 100; relative_humidity_pc <= 10000; relative_humidity_pc += 500) {
+				sink_f = psychrometrics::dew_point_float(temperature_c / 100.0f, relative_humidity_pc / 100.0f);
+				sink_f = psychrometrics::absolute_humidity_float(temperature_c / 100.0f, relative_humidity_pc / 100.0f);
+			}
+		}
+
+		unsigned long float_us = ::micros() - start_us;
+
+		(void)sink_i;
+		(void)sink_f;
+
+		shell.printfln(F("Readings:    %lu"), count);
+		shell.printfln(F("Fixed point: %lu.%03luµs/reading"), fixed_us / count, fixed_us * 1000 / count % 1000);
+		shell.printfln(F("Float:       %lu.%03luµs/reading"), float_us / count, float_us * 1000 / count % 1000);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(latency)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		const LatencyTracer &latency = to_app(shell).report().latency();
+
+		shell.printfln(F("Readings traced: %lu (1 in %u readings)"),
+			static_cast<unsigned long>(latency.count()), latency.interval());
+		shell.println();
+		shell.println(F("Stage               p50 ms     p95 ms"));
+
+		for (size_t i = 1; i < LatencyTracer::STAGES; i++) {
+			TraceStage stage = static_cast<TraceStage>(i);
+
+			shell.printfln(F("%-16S %9ld  %9ld"), LatencyTracer::name(stage),
+				static_cast<long>(latency.p50(stage)), static_cast<long>(latency.p95(stage)));
+		}
+
+		shell.printfln(F("%-16S %9ld  %9ld"), F("total"),
+			static_cast<long>(latency.total_p50()), static_cast<long>(latency.total_p95()));
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(report)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		const Report &report = to_app(shell).report();
+
+		shell.printfln(F("Stored readings: %u/%u"), report.size(), report.capacity());
+		shell.printfln(F("Clock steps:     %lu (%lu readings adjusted)"), report.clock_steps(), report.clock_repairs());
+		if (report.retry_ms() != 0) {
+			shell.printfln(F("Upload retry:    in %lus"), static_cast<unsigned long>((report.retry_ms() + 999) / 1000));
+		}
+
+		for (size_t i = 0; i < report.endpoints().size(); i++) {
+			const UploadEndpoint &endpoint = report.endpoints()[i];
+
+			shell.println();
+			shell.printfln(F("Endpoint %u: %s%S"), i + 1, endpoint.url.c_str(),
+				i == report.endpoint() ? F(" (active)") : F(""));
+			if (report.endpoint_down(endpoint)) {
+				shell.printfln(F("  Status:       down, next upload can use it in %lus"),
+					static_cast<unsigned long>((report.endpoint_retry_ms(endpoint) + 999) / 1000));
+			} else {
+				shell.printfln(F("  Status:       up"));
+			}
+
+			if (endpoint.uploads != 0) {
+				shell.printfln(F("  RTT:          %lums"), static_cast<unsigned long>(endpoint.rtt_ms));
+			} else {
+				shell.printfln(F("  RTT:          not measured"));
+			}
+			shell.printfln(F("  Failure rate: %u%%"), endpoint.failure_rate * 100U / UINT8_MAX);
+			shell.printfln(F("  Uploads:      %lu (%lu failures)"), endpoint.uploads, endpoint.errors);
+		}
+
+		if (!report.gateway().empty()) {
+			shell.println();
+			shell.printfln(F("Gateway: %s"), report.gateway().c_str());
+		}
+
+		if (!report.peers().empty()) {
+			shell.println();
+			shell.printfln(F("Peer readings: %u/%u"), report.peer_size(), report.peer_capacity());
+
+			for (const auto &peer : report.peers()) {
+				shell.printfln(F("  %-32s %lu readings, last at %u"), peer.name.c_str(), peer.readings, peer.timestamp);
+			}
+		}
+
+		if (report.aggregate_s() != 0 && !report.aggregator().empty()) {
+			ReadingSummary summary = report.aggregator().summary(report.aggregate_s());
+
+			shell.println();
+			shell.printfln(F("Current %us window from %u, %u readings:"), summary.window_s, summary.timestamp(), summary.count);
+
+			for (size_t i = 0; i < Reading::FIELDS; i++) {
+				const ReadingField &field = READING_FIELDS[i];
+
+				if (summary.minimum.get_field(i) == field.nan()) {
+					continue;
+				}
+
+				shell.printfln(F("%-17s min %.2f, p50 %.2f, p95 %.2f, max %.2f"), field.name,
+					summary.minimum.get_field(i) / static_cast<float>(field.div),
+					summary.p50.get_field(i) / static_cast<float>(field.div),
+					summary.p95.get_field(i) / static_cast<float>(field.div),
+					summary.maximum.get_field(i) / static_cast<float>(field.div));
+			}
+		}
+	});
+
 	commands->add_command(ShellContext::MAIN, CommandFlags::USER, flash_string_vector{F_(show), F_(sensor)},
 			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
 		shell.printfln(F("Sensor firmware: %s"), to_app(shell).sensor().firmware_version().c_str());
@@ -246,6 +795,13 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 		shell.printfln(F("Temperature:       %.2f°C"), to_app(shell).sensor().temperature_c());
 		shell.printfln(F("Relative humidity: %.2f%%"), to_app(shell).sensor().relative_humidity_pc());
 		shell.printfln(F("CO₂:               %.2f ppm"), to_app(shell).sensor().co2_ppm());
+		shell.printfln(F("Dew point:         %.2f°C"), to_app(shell).sensor().dew_point_c());
+		shell.printfln(F("Absolute humidity: %.2f g/m³"), to_app(shell).sensor().absolute_humidity_gm3());
+		if (to_app(shell).sensor().data_age_ms() >= 0) {
+			shell.printfln(F("Data age:          %ldms"), to_app(shell).sensor().data_age_ms());
+		} else {
+			shell.println(F("Data age:          unknown"));
+		}
 	});
 
 	commands->add_command(ShellContext::MAIN, CommandFlags::USER, CommandFlags::ADMIN,
@@ -337,6 +893,114 @@ static inline void setup_commands(std::shared_ptr<Commands> &commands) {
 		sensor_measurement_interval(shell, NO_ARGUMENTS);
 	});
 
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, CommandFlags::ADMIN,
+		flash_string_vector{F_(sensor), F_(reading), F_(adaptive)}, sensor_reading_adaptive);
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(sensor), F_(reading), F_(adaptive), F_(on)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.take_measurement_adaptive(true);
+		config.commit();
+		to_app(shell).config_sensor({Operation::TAKE_MEASUREMENT});
+		sensor_reading_adaptive(shell, NO_ARGUMENTS);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(sensor), F_(reading), F_(adaptive), F_(off)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.take_measurement_adaptive(false);
+		config.commit();
+		to_app(shell).config_sensor({Operation::TAKE_MEASUREMENT});
+		sensor_reading_adaptive(shell, NO_ARGUMENTS);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(sensor), F_(reading), F_(adaptive), F_(minimum)},
+			flash_string_vector{F_(seconds_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value < Sensor::MINIMUM_READING_INTERVAL_S || value > Sensor::MAXIMUM_READING_INTERVAL_S) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.take_measurement_minimum_interval(value);
+			config.commit();
+			to_app(shell).config_sensor({Operation::TAKE_MEASUREMENT});
+		}
+
+		sensor_reading_adaptive(shell, NO_ARGUMENTS);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(sensor), F_(reading), F_(adaptive), F_(maximum)},
+			flash_string_vector{F_(seconds_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value < Sensor::MINIMUM_READING_INTERVAL_S || value > Sensor::MAXIMUM_READING_INTERVAL_S) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.take_measurement_maximum_interval(value);
+			config.commit();
+			to_app(shell).config_sensor({Operation::TAKE_MEASUREMENT});
+		}
+
+		sensor_reading_adaptive(shell, NO_ARGUMENTS);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(sensor), F_(reading), F_(adaptive), F_(rate)},
+			flash_string_vector{F_(ppm_per_minute_optional)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments) {
+		Config config;
+
+		if (!arguments.empty()) {
+			unsigned long value = 0;
+			int ret = std::sscanf(arguments[0].c_str(), "%lu", &value);
+
+			if (ret < 1 || value < 1) {
+				shell.println(F("Invalid value"));
+				return;
+			}
+
+			config.take_measurement_rate(value);
+			config.commit();
+			to_app(shell).config_sensor({Operation::TAKE_MEASUREMENT});
+		}
+
+		sensor_reading_adaptive(shell, NO_ARGUMENTS);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::USER, CommandFlags::ADMIN,
+		flash_string_vector{F_(sensor), F_(reading), F_(align)}, sensor_reading_align);
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(sensor), F_(reading), F_(align), F_(on)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.take_measurement_align(true);
+		config.commit();
+		to_app(shell).config_sensor({Operation::TAKE_MEASUREMENT});
+		sensor_reading_align(shell, NO_ARGUMENTS);
+	});
+
+	commands->add_command(ShellContext::MAIN, CommandFlags::ADMIN, flash_string_vector{F_(sensor), F_(reading), F_(align), F_(off)},
+			[=] (Shell &shell, const std::vector<std::string> &arguments __attribute__((unused))) {
+		Config config;
+		config.take_measurement_align(false);
+		config.commit();
+		to_app(shell).config_sensor({Operation::TAKE_MEASUREMENT});
+		sensor_reading_align(shell, NO_ARGUMENTS);
+	});
+
 	commands->add_command(ShellContext::MAIN, CommandFlags::USER, CommandFlags::ADMIN,
 		flash_string_vector{F_(sensor), F_(reading), F_(interval)}, sensor_reading_interval);
 
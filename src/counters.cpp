@@ -0,0 +1,328 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/counters.h"
+
+#include <Arduino.h>
+#ifdef ARDUINO_ARCH_ESP32
+# include <esp_attr.h>
+# include <esp_system.h>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <uuid/log.h>
+
+#include "app/fs.h"
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(sizeof(int)))) PROGMEM = "counters";
+
+namespace scd30 {
+
+uuid::log::Logger Counters::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+Counters::Record Counters::lifetime_;
+uint32_t Counters::boot_[COUNTERS];
+uint32_t Counters::boot_max_loop_us_ = 0;
+uint32_t Counters::sequence_ = 1;
+ResetCause Counters::reset_cause_ = ResetCause::UNKNOWN;
+bool Counters::rtc_dirty_ = false;
+bool Counters::flash_dirty_ = false;
+uint32_t Counters::rtc_ms_ = 0;
+uint32_t Counters::flash_ms_ = 0;
+#ifdef ARDUINO_ARCH_ESP32
+RTC_NOINIT_ATTR Counters::Record Counters::rtc_;
+#endif
+
+#ifdef ARDUINO_ARCH_ESP8266
+static constexpr uint32_t RTC_OFFSET = 64; /* 4-byte blocks, away from the start of user memory */
+#endif
+#if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
+static const char *const FLASH_FILENAME = "/counters.bin";
+static const char *const FLASH_TEMP_FILENAME = "/counters.new";
+#endif
+
+void Counters::start() {
+	Record rtc;
+	Record flash;
+	bool rtc_valid = read_rtc(rtc);
+	bool flash_valid = read_flash(flash);
+
+	if (rtc_valid && (!flash_valid || rtc.updates >= flash.updates)) {
+		lifetime_ = rtc;
+	} else if (flash_valid) {
+		lifetime_ = flash;
+		flash_ms_ = ::millis();
+	} else {
+		std::memset(&lifetime_, 0, sizeof(lifetime_));
+		lifetime_.magic = MAGIC;
+	}
+
+	sequence_ = std::max(UINT32_C(1), lifetime_.sequence_reserved);
+
+	reset_cause_ = read_reset_cause();
+	lifetime_.resets[static_cast<size_t>(reset_cause_)]++;
+	logger_.info(F("Reset cause: %S (%lu times)"), name(reset_cause_),
+		static_cast<unsigned long>(lifetime_.resets[static_cast<size_t>(reset_cause_)]));
+
+	changed();
+	write_rtc();
+}
+
+void Counters::loop() {
+	if (rtc_dirty_ && ::millis() - rtc_ms_ >= RTC_INTERVAL_MS) {
+		write_rtc();
+	}
+
+	if (flash_dirty_ && ::millis() - flash_ms_ >= FLASH_INTERVAL_MS) {
+		write_flash();
+	}
+}
+
+void Counters::increment(Counter counter) {
+	size_t index = static_cast<size_t>(counter);
+
+	boot_[index]++;
+	lifetime_.counters[index]++;
+	changed();
+}
+
+void Counters::loop_time(uint32_t time_us) {
+	boot_max_loop_us_ = std::max(boot_max_loop_us_, time_us);
+
+	if (time_us > lifetime_.max_loop_us) {
+		lifetime_.max_loop_us = time_us;
+		changed();
+	}
+}
+
+uint32_t Counters::next_sequence() {
+	if (sequence_ >= lifetime_.sequence_reserved) {
+		lifetime_.sequence_reserved = sequence_ + SEQUENCE_BLOCK;
+		changed();
+		write_rtc();
+		write_flash();
+	}
+
+	return sequence_++;
+}
+
+const __FlashStringHelper *Counters::name(Counter counter) {
+	switch (counter) {
+	case Counter::MODBUS_ERRORS:
+		return F("Modbus errors");
+
+	case Counter::UPLOAD_FAILURES:
+		return F("Upload failures");
+
+	case Counter::OVERFLOW_DROPS:
+		return F("Overflow drops");
+	}
+
+	return F("?");
+}
+
+const __FlashStringHelper *Counters::name(ResetCause cause) {
+	switch (cause) {
+	case ResetCause::POWER_ON:
+		return F("power on");
+
+	case ResetCause::EXTERNAL:
+		return F("external");
+
+	case ResetCause::SOFTWARE:
+		return F("software");
+
+	case ResetCause::EXCEPTION:
+		return F("exception");
+
+	case ResetCause::WATCHDOG:
+		return F("watchdog");
+
+	case ResetCause::DEEP_SLEEP:
+		return F("deep sleep");
+
+	case ResetCause::BROWNOUT:
+		return F("brownout");
+
+	case ResetCause::UNKNOWN:
+		break;
+	}
+
+	return F("unknown");
+}
+
+void Counters::changed() {
+	lifetime_.updates++;
+	rtc_dirty_ = true;
+	flash_dirty_ = true;
+}
+
+uint32_t Counters::crc32(const Record &record) {
+	const uint8_t *data = reinterpret_cast<const uint8_t *>(&record);
+	uint32_t crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i < offsetof(Record, crc); i++) {
+		crc ^= data[i];
+
+		for (int j = 0; j < 8; j++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+
+	return ~crc;
+}
+
+bool Counters::valid(const Record &record) {
+	return record.magic == MAGIC && record.crc == crc32(record);
+}
+
+ResetCause Counters::read_reset_cause() {
+#if defined(ARDUINO_ARCH_ESP8266)
+	switch (ESP.getResetInfoPtr()->reason) {
+	case REASON_DEFAULT_RST:
+		return ResetCause::POWER_ON;
+
+	case REASON_EXT_SYS_RST:
+		return ResetCause::EXTERNAL;
+
+	case REASON_SOFT_RESTART:
+		return ResetCause::SOFTWARE;
+
+	case REASON_EXCEPTION_RST:
+		return ResetCause::EXCEPTION;
+
+	case REASON_WDT_RST:
+	case REASON_SOFT_WDT_RST:
+		return ResetCause::WATCHDOG;
+
+	case REASON_DEEP_SLEEP_AWAKE:
+		return ResetCause::DEEP_SLEEP;
+	}
+#elif defined(ARDUINO_ARCH_ESP32)
+	switch (esp_reset_reason()) {
+	case ESP_RST_POWERON:
+		return ResetCause::POWER_ON;
+
+	case ESP_RST_EXT:
+		return ResetCause::EXTERNAL;
+
+	case ESP_RST_SW:
+		return ResetCause::SOFTWARE;
+
+	case ESP_RST_PANIC:
+		return ResetCause::EXCEPTION;
+
+	case ESP_RST_INT_WDT:
+	case ESP_RST_TASK_WDT:
+	case ESP_RST_WDT:
+		return ResetCause::WATCHDOG;
+
+	case ESP_RST_DEEPSLEEP:
+		return ResetCause::DEEP_SLEEP;
+
+	case ESP_RST_BROWNOUT:
+		return ResetCause::BROWNOUT;
+
+	default:
+		break;
+	}
+#endif
+
+	return ResetCause::UNKNOWN;
+}
+
+bool Counters::read_rtc(Record &record) {
+#if defined(ARDUINO_ARCH_ESP8266)
+	if (!ESP.rtcUserMemoryRead(RTC_OFFSET, reinterpret_cast<uint32_t *>(&record), sizeof(record))) {
+		return false;
+	}
+#elif defined(ARDUINO_ARCH_ESP32)
+	record = rtc_;
+#else
+	return false;
+#endif
+
+	return valid(record);
+}
+
+void Counters::write_rtc() {
+	lifetime_.crc = crc32(lifetime_);
+
+#if defined(ARDUINO_ARCH_ESP8266)
+	ESP.rtcUserMemoryWrite(RTC_OFFSET, reinterpret_cast<uint32_t *>(&lifetime_), sizeof(lifetime_));
+#elif defined(ARDUINO_ARCH_ESP32)
+	rtc_ = lifetime_;
+#endif
+
+	rtc_dirty_ = false;
+	rtc_ms_ = ::millis();
+}
+
+bool Counters::read_flash(Record &record) {
+#if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
+	auto file = app::FS.open(FLASH_FILENAME, "r");
+
+	if (!file) {
+		return false;
+	}
+
+	bool ok = file.read(reinterpret_cast<uint8_t *>(&record), sizeof(record)) == sizeof(record);
+
+	file.close();
+
+	if (!ok) {
+		return false;
+	}
+#else
+	return false;
+#endif
+
+	return valid(record);
+}
+
+void Counters::write_flash() {
+	lifetime_.crc = crc32(lifetime_);
+	flash_dirty_ = false;
+	flash_ms_ = ::millis();
+
+#if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
+	/* Replace the file only when the new one has been written completely */
+	auto file = app::FS.open(FLASH_TEMP_FILENAME, "w");
+
+	if (!file) {
+		logger_.err(F("Unable to write counters"));
+		return;
+	}
+
+	bool ok = file.write(reinterpret_cast<const uint8_t *>(&lifetime_), sizeof(lifetime_)) == sizeof(lifetime_);
+
+	file.close();
+
+	if (!ok || !app::FS.rename(FLASH_TEMP_FILENAME, FLASH_FILENAME)) {
+		logger_.err(F("Unable to write counters"));
+		return;
+	}
+
+	logger_.trace(F("Saved counters"));
+#endif
+}
+
+} // namespace scd30
@@ -0,0 +1,142 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/gateway.h"
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+#include <algorithm>
+#include <string>
+
+#include <uuid/log.h>
+
+#include "app/config.h"
+#include "scd30/peer.h"
+#include "scd30/reading.h"
+#include "scd30/report.h"
+#include "scd30/traffic.h"
+
+using Config = ::app::Config;
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(sizeof(int)))) PROGMEM = "gateway";
+
+namespace scd30 {
+
+uuid::log::Logger Gateway::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+Gateway::Gateway(Report &report) : report_(report) {
+
+}
+
+void Gateway::config() {
+	Config config;
+	uint16_t port = std::min(static_cast<unsigned long>(UINT16_MAX), config.gateway_port());
+
+	if (port == port_) {
+		return;
+	}
+
+	if (port_ != 0) {
+		udp_.stop();
+		logger_.info(F("Stopped gateway"));
+	}
+
+	port_ = port;
+
+	if (port_ != 0) {
+		if (udp_.begin(port_)) {
+			logger_.info(F("Started gateway on port %u"), port_);
+		} else {
+			logger_.err(F("Unable to start gateway on port %u"), port_);
+			port_ = 0;
+		}
+	}
+}
+
+void Gateway::loop() {
+	if (port_ == 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < MAXIMUM_PACKETS_PER_LOOP; i++) {
+		if (udp_.parsePacket() <= 0) {
+			break;
+		}
+
+		int length = udp_.read(packet_.data(), packet_.size());
+
+		if (length > 0) {
+			size_t payload = receive(length);
+
+			Traffic::count(TrafficChannel::GATEWAY);
+			Traffic::received(TrafficChannel::GATEWAY, payload, length - payload);
+		}
+	}
+}
+
+/* Returns the number of payload bytes in a valid packet */
+size_t Gateway::receive(size_t length) {
+	uint32_t sequence;
+	const uint8_t *end = packet_.data() + length;
+	const uint8_t *pos = peer::read_header(packet_.data(), length, peer::DATA, sequence);
+
+	if (pos == nullptr || pos == end) {
+		logger_.trace(F("Invalid packet from %s"), udp_.remoteIP().toString().c_str());
+		return 0;
+	}
+
+	size_t name_length = *pos++;
+
+	if (static_cast<size_t>(end - pos) < name_length + 1
+			|| !peer::valid_name(reinterpret_cast<const char *>(pos), name_length)) {
+		logger_.trace(F("Invalid sensor name from %s"), udp_.remoteIP().toString().c_str());
+		return 0;
+	}
+
+	std::string name{reinterpret_cast<const char *>(pos), name_length};
+
+	pos += name_length;
+
+	size_t count = *pos++;
+
+	if (count > peer::MAXIMUM_READINGS
+			|| static_cast<size_t>(end - pos) != count * Reading::PACKED_BYTES) {
+		logger_.trace(F("Invalid readings from %s"), name.c_str());
+		return 0;
+	}
+
+	if (report_.add_peer(name, sequence, pos, count)) {
+		acknowledge(sequence);
+	}
+
+	return count * Reading::PACKED_BYTES;
+}
+
+void Gateway::acknowledge(uint32_t sequence) {
+	uint8_t data[peer::HEADER_BYTES];
+	uint8_t *end = peer::write_header(data, peer::ACK, sequence);
+
+	udp_.beginPacket(udp_.remoteIP(), udp_.remotePort());
+	udp_.write(data, end - data);
+	udp_.endPacket();
+
+	Traffic::sent(TrafficChannel::GATEWAY, 0, end - data);
+}
+
+} // namespace scd30
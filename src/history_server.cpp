@@ -0,0 +1,411 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/history_server.h"
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include <uuid/log.h>
+
+#include "app/config.h"
+#include "scd30/reading.h"
+#include "scd30/report.h"
+#include "scd30/traffic.h"
+
+using Config = ::app::Config;
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(sizeof(int)))) PROGMEM = "history";
+
+namespace scd30 {
+
+uuid::log::Logger HistoryServer::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+HistoryServer::HistoryServer(const Report &report) : report_(report) {
+
+}
+
+void HistoryServer::config() {
+	Config config;
+	uint16_t port = std::min(static_cast<unsigned long>(UINT16_MAX), config.history_port());
+
+	if (port == port_) {
+		return;
+	}
+
+	for (auto &connection : connections_) {
+		connection.client.stop();
+	}
+
+	if (server_) {
+		server_->stop();
+		server_.reset();
+		logger_.info(F("Stopped history server"));
+	}
+
+	port_ = port;
+
+	if (port_ != 0) {
+		server_ = std::unique_ptr<WiFiServer>{new WiFiServer{port_}};
+		server_->begin();
+		server_->setNoDelay(true);
+		logger_.info(F("Started history server on port %u"), port_);
+	}
+}
+
+void HistoryServer::loop() {
+	if (!server_) {
+		return;
+	}
+
+	WiFiClient client = server_->accept();
+
+	if (client) {
+		Connection *available = nullptr;
+
+		for (auto &connection : connections_) {
+			if (!connection.client.connected()) {
+				available = &connection;
+				break;
+			}
+		}
+
+		if (available) {
+			logger_.debug(F("Client connected from %s"), client.remoteIP().toString().c_str());
+			available->client.stop();
+			available->client = client;
+			available->activity_ms = ::millis();
+			available->state = HistoryState::REQUEST;
+			available->request_bytes = 0;
+			available->line_length = 0;
+			available->status = 200;
+			available->csv = true;
+			available->next_ts = 0;
+			available->last_ts = UINT32_MAX;
+			available->complete = false;
+			available->buffer_length = 0;
+			available->buffer_pos = 0;
+		} else {
+			logger_.debug(F("Too many clients, rejecting connection from %s"),
+				client.remoteIP().toString().c_str());
+			client.stop();
+		}
+	}
+
+	for (auto &connection : connections_) {
+		if (!connection.client.connected()) {
+			continue;
+		}
+
+		if (connection.state != HistoryState::BODY) {
+			receive(connection);
+		} else if (!send(connection)) {
+			connection.client.stop();
+			continue;
+		}
+
+		if (::millis() - connection.activity_ms >= CLIENT_TIMEOUT_MS) {
+			logger_.debug(F("Client timeout"));
+			connection.client.stop();
+		}
+	}
+}
+
+void HistoryServer::receive(Connection &connection) {
+	while (connection.state != HistoryState::BODY && connection.client.available() > 0) {
+		int c = connection.client.read();
+
+		if (c < 0) {
+			break;
+		}
+
+		connection.activity_ms = ::millis();
+		Traffic::received(TrafficChannel::HISTORY, 0, 1);
+
+		if (++connection.request_bytes > MAXIMUM_REQUEST_BYTES) {
+			logger_.debug(F("Request too long"));
+			connection.client.stop();
+			return;
+		}
+
+		if (c != '\n') {
+			if (connection.line_length < MAXIMUM_LINE_LENGTH) {
+				connection.line[connection.line_length++] = c;
+			} else if (connection.state == HistoryState::REQUEST) {
+				connection.status = 414;
+			}
+			continue;
+		}
+
+		if (connection.line_length > 0 && connection.line[connection.line_length - 1] == '\r') {
+			connection.line_length--;
+		}
+		connection.line[connection.line_length] = '\0';
+
+		if (connection.state == HistoryState::REQUEST) {
+			if (connection.status == 200) {
+				parse_request(connection);
+			}
+			connection.state = HistoryState::HEADERS;
+		} else if (connection.line_length == 0) {
+			/* Headers are ignored, the response starts after the end of the request */
+			Traffic::count(TrafficChannel::HISTORY);
+			respond(connection);
+			connection.state = HistoryState::BODY;
+		}
+
+		connection.line_length = 0;
+	}
+}
+
+bool HistoryServer::parse_value(const char *text, uint32_t &value) {
+	char *end = nullptr;
+
+	if (*text < '0' || *text > '9') {
+		return false;
+	}
+
+	unsigned long long parsed = std::strtoull(text, &end, 10);
+
+	if (*end != '\0' || parsed > UINT32_MAX) {
+		return false;
+	}
+
+	value = parsed;
+	return true;
+}
+
+void HistoryServer::parse_request(Connection &connection) {
+	char *path = connection.line.data();
+
+	if (::strncmp_P(path, PSTR("GET "), 4)) {
+		connection.status = 405;
+		return;
+	}
+
+	path += 4;
+
+	char *end = std::strchr(path, ' ');
+
+	if (end == nullptr) {
+		connection.status = 400;
+		return;
+	}
+
+	*end = '\0';
+
+	char *query = std::strchr(path, '?');
+
+	if (query != nullptr) {
+		*query++ = '\0';
+	}
+
+	if (::strcmp_P(path, PSTR("/readings"))) {
+		connection.status = 404;
+		return;
+	}
+
+	while (query != nullptr && *query != '\0') {
+		char *name = query;
+
+		query = std::strchr(query, '&');
+		if (query != nullptr) {
+			*query++ = '\0';
+		}
+
+		char *value = std::strchr(name, '=');
+
+		if (value == nullptr) {
+			connection.status = 400;
+			return;
+		}
+
+		*value++ = '\0';
+
+		if (!::strcmp_P(name, PSTR("from"))) {
+			if (!parse_value(value, connection.next_ts)) {
+				connection.status = 400;
+				return;
+			}
+		} else if (!::strcmp_P(name, PSTR("to"))) {
+			if (!parse_value(value, connection.last_ts)) {
+				connection.status = 400;
+				return;
+			}
+		} else if (!::strcmp_P(name, PSTR("format"))) {
+			if (!::strcmp_P(value, PSTR("csv"))) {
+				connection.csv = true;
+			} else if (!::strcmp_P(value, PSTR("binary"))) {
+				connection.csv = false;
+			} else {
+				connection.status = 400;
+				return;
+			}
+		}
+	}
+
+	logger_.debug(F("Request for readings from %u to %u (%S)"), connection.next_ts, connection.last_ts,
+		connection.csv ? F("CSV") : F("binary"));
+}
+
+void HistoryServer::respond(Connection &connection) {
+	const __FlashStringHelper *reason;
+	char *text = reinterpret_cast<char *>(connection.buffer.data());
+
+	switch (connection.status) {
+	case 200:
+		reason = F("OK");
+		break;
+
+	case 404:
+		reason = F("Not Found");
+		break;
+
+	case 405:
+		reason = F("Method Not Allowed");
+		break;
+
+	case 414:
+		reason = F("URI Too Long");
+		break;
+
+	default:
+		connection.status = 400;
+		reason = F("Bad Request");
+		break;
+	}
+
+	int len = snprintf_P(text, connection.buffer.size(),
+		PSTR("HTTP/1.1 %d %S\r\n"
+			"Content-Type: %S\r\n"
+			"Connection: close\r\n"
+			"\r\n"),
+		connection.status, reason,
+		connection.status != 200 ? F("text/plain")
+			: (connection.csv ? F("text/csv") : F("application/octet-stream")));
+
+	if (len < 0 || static_cast<size_t>(len) >= connection.buffer.size()) {
+		connection.client.stop();
+		return;
+	}
+
+	/* Space for the rest of the response is much larger than the header */
+	connection.buffer_length = len;
+	connection.buffer_pos = 0;
+	Traffic::sent(TrafficChannel::HISTORY, 0, len);
+
+	if (connection.status != 200) {
+		size_t space = connection.buffer.size() - connection.buffer_length;
+
+		len = snprintf_P(text + connection.buffer_length, space, PSTR("%S\n"), reason);
+
+		/* Only what fitted in the buffer (excluding the null terminator) is sent */
+		size_t body_length = std::min(static_cast<size_t>(std::max(0, len)), space - 1);
+
+		connection.buffer_length += body_length;
+		connection.complete = true;
+		Traffic::sent(TrafficChannel::HISTORY, 0, body_length);
+	} else if (connection.csv) {
+		char *pos = text + connection.buffer_length;
+
+		pos = std::copy_n("timestamp", 9, pos);
+
+		for (size_t i = 0; i < Reading::FIELDS; i++) {
+			*pos++ = ',';
+			pos = std::copy_n(READING_FIELDS[i].name, std::strlen(READING_FIELDS[i].name), pos);
+		}
+
+		*pos++ = '\n';
+		Traffic::sent(TrafficChannel::HISTORY, pos - (text + connection.buffer_length), 0);
+		connection.buffer_length = pos - text;
+	}
+}
+
+/* Read the next readings from the store into the buffer */
+void HistoryServer::fill(Connection &connection) {
+	auto range = report_.find(connection.next_ts, connection.last_ts);
+	auto it = range.first;
+	uint8_t *pos = connection.buffer.data();
+	uint8_t *end = pos + connection.buffer.size();
+
+	for (; it != range.second; ++it) {
+		if (connection.csv) {
+			if (static_cast<size_t>(end - pos) < Reading::CSV_LENGTH + 1) {
+				break;
+			}
+
+			pos = reinterpret_cast<uint8_t *>(it->format_csv(reinterpret_cast<char *>(pos)));
+			*pos++ = '\n';
+		} else {
+			if (static_cast<size_t>(end - pos) < Reading::PACKED_BYTES) {
+				break;
+			}
+
+			it->pack(pos);
+			pos += Reading::PACKED_BYTES;
+		}
+
+		/* The next timestamp would wrap if the last timestamp is UINT32_MAX */
+		if (it->timestamp == connection.last_ts) {
+			++it;
+			break;
+		}
+
+		connection.next_ts = it->timestamp + 1;
+	}
+
+	connection.complete = (it == range.second);
+	connection.buffer_length = pos - connection.buffer.data();
+	connection.buffer_pos = 0;
+	Traffic::sent(TrafficChannel::HISTORY, connection.buffer_length, 0);
+}
+
+/* Returns false when the response is finished or can't be sent */
+bool HistoryServer::send(Connection &connection) {
+	if (connection.buffer_pos == connection.buffer_length) {
+		if (connection.complete) {
+			return false;
+		}
+
+		fill(connection);
+
+		if (connection.buffer_length == 0) {
+			return false;
+		}
+	}
+
+	size_t len = connection.client.write(&connection.buffer[connection.buffer_pos],
+		connection.buffer_length - connection.buffer_pos);
+
+	if (len == 0) {
+		return false;
+	}
+
+	connection.buffer_pos += len;
+	connection.activity_ms = ::millis();
+	return true;
+}
+
+} // namespace scd30
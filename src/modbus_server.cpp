@@ -0,0 +1,304 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/modbus_server.h"
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+
+#include <uuid/common.h>
+#include <uuid/log.h>
+
+#include "app/config.h"
+#include "scd30/reading.h"
+#include "scd30/report.h"
+#include "scd30/sensor.h"
+#include "scd30/traffic.h"
+
+using Config = ::app::Config;
+
+static const char __pstr__logger_name[] __attribute__((__aligned__(sizeof(int)))) PROGMEM = "modbus";
+
+namespace scd30 {
+
+uuid::log::Logger ModbusServer::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
+
+void ModbusServer::config() {
+	Config config;
+	uint16_t port = std::min(static_cast<unsigned long>(UINT16_MAX), config.modbus_port());
+
+	if (port == port_) {
+		return;
+	}
+
+	for (auto &connection : connections_) {
+		connection.client.stop();
+	}
+
+	if (server_) {
+		server_->stop();
+		server_.reset();
+		logger_.info(F("Stopped Modbus TCP server"));
+	}
+
+	port_ = port;
+
+	if (port_ != 0) {
+		server_ = std::unique_ptr<WiFiServer>{new WiFiServer{port_}};
+		server_->begin();
+		server_->setNoDelay(true);
+		logger_.info(F("Started Modbus TCP server on port %u"), port_);
+	}
+}
+
+static inline uint16_t encode_signed(float value, int32_t multiplier) {
+	if (!std::isfinite(value)) {
+		return static_cast<uint16_t>(INT16_MIN);
+	}
+
+	return static_cast<uint16_t>(std::max(INT16_MIN + 1L, std::min(static_cast<long>(INT16_MAX), std::lround(value * multiplier))));
+}
+
+static inline uint16_t encode_unsigned(float value, int32_t multiplier) {
+	if (!std::isfinite(value)) {
+		return UINT16_MAX;
+	}
+
+	return std::max(0L, std::min(UINT16_MAX - 1L, std::lround(value * multiplier)));
+}
+
+void ModbusServer::set32(size_t address, uint32_t value) {
+	registers_[address] = value >> 16;
+	registers_[address + 1] = value & 0xFFFF;
+}
+
+ModbusServer::ModbusServer() {
+	/* Measurements are not available until the first reading */
+	registers_[2] = encode_signed(NAN, 100);
+	registers_[3] = encode_unsigned(NAN, 100);
+	registers_[4] = encode_unsigned(NAN, 1);
+	registers_[5] = encode_signed(NAN, 100);
+	registers_[6] = encode_unsigned(NAN, 100);
+	registers_[7] = encode_unsigned(NAN, 1);
+
+	for (size_t i = 0; i < Reading::FIELDS; i++) {
+		for (size_t j = 0; j < 4; j++) {
+			registers_[18 + i * 4 + j] = READING_FIELDS[i].is_signed
+				? encode_signed(NAN, 1) : encode_unsigned(NAN, 1);
+		}
+	}
+}
+
+/* Called when there's a new reading, so that requests are served from a snapshot */
+void ModbusServer::update(const Sensor &sensor, const Report &report) {
+	if (!server_) {
+		return;
+	}
+
+	set32(0, sensor.last_reading_s());
+	registers_[2] = encode_signed(sensor.temperature_c(), 100);
+	registers_[3] = encode_unsigned(sensor.relative_humidity_pc(), 100);
+	registers_[4] = encode_unsigned(sensor.co2_ppm(), 1);
+	registers_[5] = encode_signed(sensor.dew_point_c(), 100);
+	registers_[6] = encode_unsigned(sensor.absolute_humidity_gm3(), 100);
+	registers_[7] = encode_unsigned(sensor.data_age_ms() >= 0 ? sensor.data_age_ms() : NAN, 1);
+	registers_[8] = sensor.reading_interval_s();
+
+	registers_[16] = report.aggregate_s();
+
+	bool window = report.aggregate_s() != 0 && !report.aggregator().empty();
+	ReadingSummary summary = report.aggregator().summary(report.aggregate_s());
+
+	registers_[17] = window ? summary.count : 0;
+
+	for (size_t i = 0; i < Reading::FIELDS; i++) {
+		const ReadingField &field = READING_FIELDS[i];
+		const Reading *values[] = { &summary.minimum, &summary.p50, &summary.p95, &summary.maximum };
+		/* CO₂ is in ppm, everything else has two decimal places */
+		int32_t multiplier = i == Reading::CO2 ? 1 : 100;
+
+		for (size_t j = 0; j < 4; j++) {
+			int32_t value = values[j]->get_field(i);
+			float fvalue = window && value != field.nan() ? value / static_cast<float>(field.div) : NAN;
+
+			registers_[18 + i * 4 + j] = field.is_signed
+				? encode_signed(fvalue, multiplier) : encode_unsigned(fvalue, multiplier);
+		}
+	}
+
+	registers_[34] = std::min(report.size(), static_cast<size_t>(UINT16_MAX));
+	registers_[35] = std::min(report.capacity(), static_cast<size_t>(UINT16_MAX));
+	set32(36, report.uploads());
+	set32(38, report.upload_errors());
+	registers_[40] = std::min(report.clock_steps(), static_cast<unsigned long>(UINT16_MAX));
+}
+
+void ModbusServer::loop() {
+	if (!server_) {
+		return;
+	}
+
+	WiFiClient client = server_->accept();
+
+	if (client) {
+		Connection *available = nullptr;
+
+		for (auto &connection : connections_) {
+			if (!connection.client.connected()) {
+				available = &connection;
+				break;
+			}
+		}
+
+		if (available) {
+			logger_.debug(F("Client connected from %s"), client.remoteIP().toString().c_str());
+			available->client.stop();
+			available->client = client;
+			available->activity_ms = ::millis();
+			available->length = 0;
+		} else {
+			logger_.debug(F("Too many clients, rejecting connection from %s"),
+				client.remoteIP().toString().c_str());
+			client.stop();
+		}
+	}
+
+	for (auto &connection : connections_) {
+		if (!connection.client.connected()) {
+			continue;
+		}
+
+		if (receive(connection)) {
+			Traffic::count(TrafficChannel::MODBUS_TCP);
+			Traffic::received(TrafficChannel::MODBUS_TCP, 0, connection.length);
+			respond(connection);
+			connection.length = 0;
+			connection.activity_ms = ::millis();
+		} else if (::millis() - connection.activity_ms >= CLIENT_TIMEOUT_MS) {
+			logger_.debug(F("Client timeout"));
+			connection.client.stop();
+		}
+	}
+}
+
+/* Returns true when a complete request frame has been received */
+bool ModbusServer::receive(Connection &connection) {
+	while (connection.client.available() > 0) {
+		size_t wanted = MBAP_HEADER_BYTES;
+
+		if (connection.length >= MBAP_HEADER_BYTES) {
+			/* Length field includes the unit identifier */
+			size_t length = (connection.frame[4] << 8) | connection.frame[5];
+
+			if (length < 2 || MBAP_HEADER_BYTES - 1 + length > MAXIMUM_FRAME_BYTES
+					|| connection.frame[2] != 0 || connection.frame[3] != 0) {
+				logger_.debug(F("Invalid frame header"));
+				connection.client.stop();
+				return false;
+			}
+
+			wanted = MBAP_HEADER_BYTES - 1 + length;
+		}
+
+		if (connection.length == wanted) {
+			return true;
+		}
+
+		int len = connection.client.read(&connection.frame[connection.length], wanted - connection.length);
+
+		if (len <= 0) {
+			break;
+		}
+
+		connection.length += len;
+	}
+
+	if (connection.length > MBAP_HEADER_BYTES) {
+		size_t length = (connection.frame[4] << 8) | connection.frame[5];
+
+		return connection.length == MBAP_HEADER_BYTES - 1 + length;
+	}
+
+	return false;
+}
+
+void ModbusServer::respond(Connection &connection) {
+	auto &frame = connection.frame;
+	uint8_t function = frame[MBAP_HEADER_BYTES];
+
+	if (function != FUNCTION_READ_INPUT_REGISTERS && function != FUNCTION_READ_HOLDING_REGISTERS) {
+		respond_exception(connection, EXCEPTION_ILLEGAL_FUNCTION);
+		return;
+	}
+
+	if (connection.length != MBAP_HEADER_BYTES + 5) {
+		respond_exception(connection, EXCEPTION_ILLEGAL_DATA_VALUE);
+		return;
+	}
+
+	uint16_t address = (frame[MBAP_HEADER_BYTES + 1] << 8) | frame[MBAP_HEADER_BYTES + 2];
+	uint16_t quantity = (frame[MBAP_HEADER_BYTES + 3] << 8) | frame[MBAP_HEADER_BYTES + 4];
+
+	if (quantity < 1 || quantity > MAXIMUM_READ_REGISTERS) {
+		respond_exception(connection, EXCEPTION_ILLEGAL_DATA_VALUE);
+		return;
+	}
+
+	if (static_cast<size_t>(address) + quantity > REGISTERS) {
+		respond_exception(connection, EXCEPTION_ILLEGAL_DATA_ADDRESS);
+		return;
+	}
+
+	/* Everything else is from the most recent reading */
+	set32(32, uuid::get_uptime_ms() / 1000);
+
+	size_t length = 3 + quantity * 2;
+
+	frame[4] = (length >> 8) & 0xFF;
+	frame[5] = length & 0xFF;
+	/* Function code is unchanged */
+	frame[MBAP_HEADER_BYTES + 1] = quantity * 2;
+
+	for (size_t i = 0; i < quantity; i++) {
+		frame[MBAP_HEADER_BYTES + 2 + i * 2] = registers_[address + i] >> 8;
+		frame[MBAP_HEADER_BYTES + 3 + i * 2] = registers_[address + i] & 0xFF;
+	}
+
+	connection.client.write(frame.data(), MBAP_HEADER_BYTES - 1 + length);
+	Traffic::sent(TrafficChannel::MODBUS_TCP, quantity * 2, MBAP_HEADER_BYTES - 1 + length - quantity * 2);
+}
+
+void ModbusServer::respond_exception(Connection &connection, uint8_t code) {
+	auto &frame = connection.frame;
+
+	frame[4] = 0;
+	frame[5] = 3;
+	frame[MBAP_HEADER_BYTES] |= 0x80;
+	frame[MBAP_HEADER_BYTES + 1] = code;
+
+	connection.client.write(frame.data(), MBAP_HEADER_BYTES + 2);
+	Traffic::sent(TrafficChannel::MODBUS_TCP, 0, MBAP_HEADER_BYTES + 2);
+}
+
+} // namespace scd30
@@ -0,0 +1,187 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/psychrometrics.h"
+
+#ifdef ARDUINO
+# include <Arduino.h>
+#else
+# define PROGMEM
+# define pgm_read_dword(addr) (*(addr))
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "scd30/reading.h"
+
+namespace scd30 {
+
+namespace psychrometrics {
+
+static constexpr unsigned int Q = 16;
+static constexpr int32_t LN2_Q16 = 45426;
+static constexpr int32_t LOG2E_Q16 = 94548;
+static constexpr int32_t LOG2_10000_Q16 = 870824;
+
+/* Magnus coefficients, b in Q16 and c in 0.01°C */
+static constexpr int32_t B_Q16 = 1154744; /* 17.62 */
+static constexpr int32_t B_100 = 1762;
+static constexpr int32_t C_100 = 24312; /* 243.12°C */
+
+/* 216.7 g·K/(m³·hPa) × 6.112 hPa, × 100 */
+static constexpr int64_t AH_COEFFICIENT_100 = 132447;
+static constexpr int32_t KELVIN_100 = 27315;
+
+static constexpr unsigned int TABLE_BITS = 6;
+
+/* log2(1 + i/64) in Q16 */
+static const uint32_t log2_table[(1U << TABLE_BITS) + 1] PROGMEM = {
+	0, 1466, 2909, 4331, 5732, 7112, 8473, 9814, 11136, 12440, 13727, 14996,
+	16248, 17484, 18704, 19909, 21098, 22272, 23433, 24579, 25711, 26830, 27936,
+	29029, 30109, 31178, 32234, 33279, 34312, 35334, 36346, 37346, 38336, 39316,
+	40286, 41246, 42196, 43137, 44068, 44990, 45904, 46809, 47705, 48593, 49472,
+	50344, 51207, 52063, 52911, 53751, 54584, 55410, 56229, 57040, 57845, 58643,
+	59434, 60219, 60997, 61769, 62534, 63294, 64047, 64794, 65536,
+};
+
+/* exp2(i/64) in Q16 */
+static const uint32_t exp2_table[(1U << TABLE_BITS) + 1] PROGMEM = {
+	65536, 66250, 66971, 67700, 68438, 69183, 69936, 70698, 71468, 72246, 73032,
+	73828, 74632, 75444, 76266, 77096, 77936, 78785, 79642, 80510, 81386, 82273,
+	83169, 84074, 84990, 85915, 86851, 87796, 88752, 89719, 90696, 91684, 92682,
+	93691, 94711, 95743, 96785, 97839, 98905, 99982, 101070, 102171, 103283,
+	104408, 105545, 106694, 107856, 109031, 110218, 111418, 112631, 113858,
+	115098, 116351, 117618, 118899, 120194, 121502, 122825, 124163, 125515,
+	126882, 128263, 129660, 131072,
+};
+
+static inline int32_t interpolate(const uint32_t *table, uint32_t fraction_q16) {
+	constexpr unsigned int shift = Q - TABLE_BITS;
+	uint32_t index = fraction_q16 >> shift;
+	uint32_t offset = fraction_q16 & ((1U << shift) - 1);
+	uint32_t low = pgm_read_dword(&table[index]);
+	uint32_t high = pgm_read_dword(&table[index + 1]);
+
+	return low + (((high - low) * offset + (1U << (shift - 1))) >> shift);
+}
+
+/* log2(value) in Q16, value must be non-zero */
+static int32_t log2_q16(uint32_t value) {
+	int exponent = 31 - __builtin_clz(value);
+	uint32_t mantissa = value << (31 - exponent);
+
+	return (exponent << Q) + interpolate(log2_table, (mantissa >> (31 - Q)) & ((1U << Q) - 1));
+}
+
+/* b·T/(c + T) in Q16 */
+static int32_t magnus_exponent_q16(int32_t temperature_c) {
+	return (static_cast<int64_t>(B_100) * temperature_c << Q) / (static_cast<int64_t>(100) * (C_100 + temperature_c));
+}
+
+static inline bool valid(int32_t temperature_c, int32_t relative_humidity_pc) {
+	return temperature_c != READING_FIELDS[Reading::TEMPERATURE].nan()
+		&& relative_humidity_pc != READING_FIELDS[Reading::RELATIVE_HUMIDITY].nan()
+		&& temperature_c >= READING_FIELDS[Reading::TEMPERATURE].min()
+		&& temperature_c <= READING_FIELDS[Reading::TEMPERATURE].max()
+		&& relative_humidity_pc >= READING_FIELDS[Reading::RELATIVE_HUMIDITY].min()
+		&& relative_humidity_pc <= READING_FIELDS[Reading::RELATIVE_HUMIDITY].max();
+}
+
+static inline int32_t clamp(const ReadingField &field, int64_t value) {
+	return std::max(static_cast<int64_t>(field.min()), std::min(static_cast<int64_t>(field.max()), value));
+}
+
+int32_t dew_point(int32_t temperature_c, int32_t relative_humidity_pc) {
+	const ReadingField &field = DERIVED_FIELDS[DEW_POINT];
+
+	if (!valid(temperature_c, relative_humidity_pc) || relative_humidity_pc == 0) {
+		return field.nan();
+	}
+
+	/* γ = ln(RH/100%) + b·T/(c + T) */
+	int32_t gamma = ((static_cast<int64_t>(log2_q16(relative_humidity_pc) - LOG2_10000_Q16) * LN2_Q16) >> Q)
+		+ magnus_exponent_q16(temperature_c);
+	int64_t numerator = static_cast<int64_t>(C_100) * gamma;
+	int64_t denominator = B_Q16 - gamma;
+
+	if (denominator <= 0) {
+		return field.nan();
+	}
+
+	/* Td = c·γ/(b - γ), rounded */
+	if (numerator >= 0) {
+		numerator += denominator / 2;
+	} else {
+		numerator -= denominator / 2;
+	}
+
+	return clamp(field, numerator / denominator);
+}
+
+int32_t absolute_humidity(int32_t temperature_c, int32_t relative_humidity_pc) {
+	const ReadingField &field = DERIVED_FIELDS[ABSOLUTE_HUMIDITY];
+
+	if (!valid(temperature_c, relative_humidity_pc)) {
+		return field.nan();
+	}
+
+	/* exp(b·T/(c + T)) = 2^p × 2^(f/2^16) */
+	int32_t exponent = (static_cast<int64_t>(magnus_exponent_q16(temperature_c)) * LOG2E_Q16) >> Q;
+	int32_t power = exponent >> Q;
+	uint32_t mantissa = interpolate(exp2_table, exponent & ((1 << Q) - 1));
+
+	/* AH = 216.7 × 6.112 × RH/100% × exp(b·T/(c + T)) / (273.15 + T) */
+	uint64_t numerator = AH_COEFFICIENT_100 * relative_humidity_pc * mantissa;
+	uint64_t denominator = (static_cast<uint64_t>(100) * (KELVIN_100 + temperature_c)) << Q;
+
+	if (power >= 0) {
+		numerator <<= power;
+	} else {
+		numerator >>= -power;
+	}
+
+	return clamp(field, (numerator + denominator / 2) / denominator);
+}
+
+float dew_point_float(float temperature_c, float relative_humidity_pc) {
+	float gamma = logf(relative_humidity_pc / 100.0f) + 17.62f * temperature_c / (243.12f + temperature_c);
+
+	return 243.12f * gamma / (17.62f - gamma);
+}
+
+float absolute_humidity_float(float temperature_c, float relative_humidity_pc) {
+	return 216.7f * (relative_humidity_pc / 100.0f * 6.112f
+		* expf(17.62f * temperature_c / (243.12f + temperature_c))) / (273.15f + temperature_c);
+}
+
+char *format_text(const Reading &reading, char *text) {
+	int32_t temperature_c = reading.get<Reading::TEMPERATURE>();
+	int32_t relative_humidity_pc = reading.get<Reading::RELATIVE_HUMIDITY>();
+
+	text = Reading::format_value(text, DERIVED_FIELDS[DEW_POINT],
+		dew_point(temperature_c, relative_humidity_pc));
+	return Reading::format_value(text, DERIVED_FIELDS[ABSOLUTE_HUMIDITY],
+		absolute_humidity(temperature_c, relative_humidity_pc));
+}
+
+} // namespace psychrometrics
+
+} // namespace scd30
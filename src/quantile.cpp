@@ -0,0 +1,145 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/quantile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace scd30 {
+
+QuantileSketch::QuantileSketch(float quantile) : quantile_(quantile) {
+	reset();
+}
+
+void QuantileSketch::reset() {
+	count_ = 0;
+
+	for (size_t i = 0; i < MARKERS; i++) {
+		height_[i] = 0;
+		position_[i] = i;
+	}
+
+	desired_[0] = 0;
+	desired_[1] = 2 * quantile_;
+	desired_[2] = 4 * quantile_;
+	desired_[3] = 2 + 2 * quantile_;
+	desired_[4] = 4;
+}
+
+void QuantileSketch::add(int32_t value) {
+	float x = value;
+
+	if (count_ < MARKERS) {
+		height_[count_++] = x;
+
+		if (count_ == MARKERS) {
+			std::sort(&height_[0], &height_[MARKERS]);
+		}
+		return;
+	}
+
+	size_t k;
+
+	if (x < height_[0]) {
+		height_[0] = x;
+		k = 0;
+	} else if (x >= height_[MARKERS - 1]) {
+		height_[MARKERS - 1] = x;
+		k = MARKERS - 2;
+	} else {
+		k = 0;
+		while (k < MARKERS - 2 && x >= height_[k + 1]) {
+			k++;
+		}
+	}
+
+	count_++;
+
+	for (size_t i = k + 1; i < MARKERS; i++) {
+		position_[i]++;
+	}
+
+	desired_[1] += quantile_ / 2;
+	desired_[2] += quantile_;
+	desired_[3] += (1 + quantile_) / 2;
+	desired_[4] += 1;
+
+	/* Adjust the heights of the middle markers if they're out of position */
+	for (size_t i = 1; i < MARKERS - 1; i++) {
+		float delta = desired_[i] - position_[i];
+
+		if ((delta >= 1 && position_[i + 1] - position_[i] > 1)
+				|| (delta <= -1 && position_[i - 1] - position_[i] < -1)) {
+			int d = delta >= 0 ? 1 : -1;
+			float height = parabolic(i, d);
+
+			if (height_[i - 1] < height && height < height_[i + 1]) {
+				height_[i] = height;
+			} else {
+				height_[i] = linear(i, d);
+			}
+
+			position_[i] += d;
+		}
+	}
+}
+
+float QuantileSketch::parabolic(size_t i, int d) const {
+	float n_prev = position_[i - 1];
+	float n = position_[i];
+	float n_next = position_[i + 1];
+
+	return height_[i] + d / (n_next - n_prev)
+		* ((n - n_prev + d) * (height_[i + 1] - height_[i]) / (n_next - n)
+			+ (n_next - n - d) * (height_[i] - height_[i - 1]) / (n - n_prev));
+}
+
+float QuantileSketch::linear(size_t i, int d) const {
+	return height_[i] + d * (height_[i + d] - height_[i]) / (position_[i + d] - position_[i]);
+}
+
+int32_t QuantileSketch::estimate() const {
+	if (count_ == 0) {
+		return 0;
+	}
+
+	if (count_ <= MARKERS) {
+		size_t count = count_ < MARKERS ? count_ : MARKERS;
+		float sorted[MARKERS];
+
+		/* Insertion sort, there are at most MARKERS values */
+		for (size_t i = 0; i < count; i++) {
+			size_t j = i;
+
+			for (; j > 0 && sorted[j - 1] > height_[i]; j--) {
+				sorted[j] = sorted[j - 1];
+			}
+
+			sorted[j] = height_[i];
+		}
+
+		return std::lround(sorted[static_cast<size_t>(std::lround(quantile_ * (count - 1)))]);
+	}
+
+	return std::lround(height_[2]);
+}
+
+} // namespace scd30
@@ -1,6 +1,6 @@
 /*
  * scd30 - SCD30 Monitor
- * Copyright 2022  Simon Arlott
+ * Copyright 2022,2026  Simon Arlott
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -20,13 +20,18 @@
 
 #include <Arduino.h>
 #ifdef ARDUINO_ARCH_ESP8266
-# include <ESP8266HTTPClient.h>
 # include <WiFiClientSecureBearSSL.h>
-#else
-# include <HTTPClient.h>
 #endif
+#include <WiFiClient.h>
+#include <WiFiUdp.h>
 
-#include <cmath>
+#include <time.h>
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -34,6 +39,11 @@
 
 #include "app/config.h"
 #include "app/fs.h"
+#include "scd30/boot.h"
+#include "scd30/counters.h"
+#include "scd30/peer.h"
+#include "scd30/psychrometrics.h"
+#include "scd30/traffic.h"
 
 using Config = ::app::Config;
 
@@ -43,6 +53,121 @@ namespace scd30 {
 
 uuid::log::Logger Report::logger_{FPSTR(__pstr__logger_name), uuid::log::Facility::DAEMON};
 
+static inline uint32_t record_timestamp(const Reading &reading) {
+	return reading.timestamp;
+}
+
+static inline uint32_t record_timestamp(const ReadingSummary &summary) {
+	return summary.timestamp();
+}
+
+/* First record at or after the timestamp */
+template <class Iterator>
+static inline Iterator lower_bound(Iterator begin, Iterator end, uint32_t timestamp) {
+	return std::lower_bound(begin, end, timestamp,
+		[] (const decltype(*begin) &record, uint32_t value) { return record_timestamp(record) < value; });
+}
+
+/* First record after the timestamp */
+template <class Iterator>
+static inline Iterator upper_bound(Iterator begin, Iterator end, uint32_t timestamp) {
+	return std::upper_bound(begin, end, timestamp,
+		[] (uint32_t value, const decltype(*begin) &record) { return value < record_timestamp(record); });
+}
+
+constexpr float ReadingAggregator::MEDIAN;
+constexpr float ReadingAggregator::UPPER_PERCENTILE;
+constexpr size_t Report::MINIMUM_STORE_READINGS;
+constexpr size_t Report::MAXIMUM_STORE_READINGS;
+constexpr unsigned long Report::MAXIMUM_STORE_MEMORY_PC;
+constexpr uint32_t Report::RETRY_MAXIMUM_MS;
+constexpr size_t Report::TLS_RESERVE_BYTES;
+
+ReadingAggregator::ReadingAggregator() {
+	for (size_t i = 0; i < Reading::FIELDS; i++) {
+		p50_[i] = QuantileSketch{MEDIAN};
+		p95_[i] = QuantileSketch{UPPER_PERCENTILE};
+	}
+
+	reset(0);
+}
+
+void ReadingAggregator::reset(uint32_t start) {
+	start_ = start;
+	count_ = 0;
+
+	for (size_t i = 0; i < Reading::FIELDS; i++) {
+		field_count_[i] = 0;
+		sum_[i] = 0;
+		minimum_[i] = READING_FIELDS[i].nan();
+		maximum_[i] = READING_FIELDS[i].nan();
+		p50_[i].reset();
+		p95_[i].reset();
+	}
+}
+
+void ReadingAggregator::add(const Reading &reading) {
+	if (count_ == UINT16_MAX) {
+		return;
+	}
+
+	count_++;
+
+	for (size_t i = 0; i < Reading::FIELDS; i++) {
+		int32_t value = reading.get_field(i);
+
+		if (value == READING_FIELDS[i].nan()) {
+			continue;
+		}
+
+		if (field_count_[i] == 0) {
+			minimum_[i] = value;
+			maximum_[i] = value;
+		} else {
+			minimum_[i] = std::min(minimum_[i], value);
+			maximum_[i] = std::max(maximum_[i], value);
+		}
+
+		field_count_[i]++;
+		sum_[i] += value;
+		p50_[i].add(value);
+		p95_[i].add(value);
+	}
+}
+
+Reading ReadingAggregator::mean() const {
+	Reading reading{start_};
+
+	for (size_t i = 0; i < Reading::FIELDS; i++) {
+		if (field_count_[i] > 0) {
+			int64_t half = field_count_[i] / 2;
+
+			reading.set_field(i, (sum_[i] + (sum_[i] < 0 ? -half : half)) / field_count_[i]);
+		}
+	}
+
+	return reading;
+}
+
+ReadingSummary ReadingAggregator::summary(uint16_t window_s) const {
+	Reading minimum{start_};
+	Reading maximum{start_};
+	Reading p50{start_};
+	Reading p95{start_};
+
+	for (size_t i = 0; i < Reading::FIELDS; i++) {
+		minimum.set_field(i, minimum_[i]);
+		maximum.set_field(i, maximum_[i]);
+
+		if (field_count_[i] > 0) {
+			p50.set_field(i, p50_[i].estimate());
+			p95.set_field(i, p95_[i].estimate());
+		}
+	}
+
+	return ReadingSummary{minimum, maximum, p50, p95, count_, window_s};
+}
+
 void Report::config() {
 	Config config;
 
@@ -50,26 +175,130 @@ void Report::config() {
 
 	enabled_ = config.report_enabled();
 	threshold_ = config.report_threshold();
-	url_ = config.report_url();
+	max_latency_s_ = config.report_max_latency();
+	derived_ = config.report_derived();
+	quantiles_ = config.report_quantiles();
+	latency_ = config.report_latency();
+	backfill_batch_ = config.report_backfill_batch();
+
+	uint16_t aggregate_s = std::min(static_cast<unsigned long>(UINT16_MAX), config.report_aggregate());
+
+	if (aggregate_s != aggregate_s_) {
+		flush_aggregate();
+		aggregate_s_ = aggregate_s;
+
+		/* Summaries need to be stored too */
+		if (capacity_ != 0) {
+			resize();
+		}
+	}
+
+	/* Sample readings for latency tracing across the whole of each upload */
+	size_t upload_readings = threshold_;
+	unsigned long interval_s = config.take_measurement_interval();
+
+	if (aggregate_s_ != 0 && interval_s != 0) {
+		upload_readings *= std::max(1UL, aggregate_s_ / interval_s);
+	}
+
+	tracer_.sample(upload_readings);
+
+	pipeline_ = std::max(1UL, std::min(static_cast<unsigned long>(MAXIMUM_PIPELINE), config.report_pipeline()));
+
+	unsigned long capacity_config = config.report_capacity();
+	unsigned long memory_pc = std::min(MAXIMUM_STORE_MEMORY_PC, config.report_memory());
+
+	bool gateway_server = config.gateway_port() != 0;
+
+	if (capacity_config != capacity_config_ || memory_pc != memory_pc_ || gateway_server != gateway_server_) {
+		capacity_config_ = capacity_config;
+		memory_pc_ = memory_pc;
+		gateway_server_ = gateway_server;
+
+		/* At boot the store is sized when the first reading is added */
+		if (capacity_ != 0) {
+			resize();
+		}
+	}
+
+	std::string urls = config.report_url();
+	std::vector<UploadEndpoint> endpoints;
+	std::string current_url;
+	size_t pos = 0;
+
+	if (endpoint_ < endpoints_.size()) {
+		current_url = endpoints_[endpoint_].url;
+	}
+
+	while (endpoints.size() < MAXIMUM_ENDPOINTS) {
+		pos = urls.find_first_not_of(' ', pos);
+		if (pos == std::string::npos) {
+			break;
+		}
+
+		size_t end = urls.find(' ', pos);
+		UploadEndpoint endpoint;
+
+		endpoint.url = urls.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+
+		auto existing = std::find_if(endpoints_.begin(), endpoints_.end(),
+			[&endpoint] (const UploadEndpoint &other) { return other.url == endpoint.url; });
+
+		if (existing != endpoints_.end()) {
+			/* Keep the health of endpoints that haven't changed */
+			endpoints.push_back(*existing);
+		} else if (parse_url(endpoint)) {
+			endpoints.push_back(endpoint);
+		} else {
+			logger_.err(F("Invalid URL: %s"), endpoint.url.c_str());
+		}
+
+		pos = end;
+	}
+
+	endpoints_ = std::move(endpoints);
+
 	username_ = config.report_username();
 	password_ = config.report_password();
 	sensor_name_ = config.report_sensor_name();
 
-	if (threshold_ == 0) {
-		enabled_ = false;
-	}
+	std::string gateway = config.report_gateway();
+	size_t colon = gateway.find(':');
 
-	if (url_.empty()
-			|| (url_.rfind(uuid::read_flash_string(F("https://")), 0) != 0
-				&& url_.rfind(uuid::read_flash_string(F("http://")), 0) != 0)) {
-		enabled_ = false;
+	gateway_host_ = gateway.substr(0, colon);
+	gateway_port_ = peer::DEFAULT_PORT;
+
+	if (colon != std::string::npos) {
+		unsigned long port = std::strtoul(gateway.c_str() + colon + 1, nullptr, 10);
+
+		if (port > 0 && port <= UINT16_MAX) {
+			gateway_port_ = port;
+		} else {
+			logger_.err(F("Invalid gateway port: %s"), gateway.c_str());
+			gateway_host_.clear();
+		}
 	}
 
-	if (username_.empty()) {
+	gateway_udp_.stop();
+
+	if (threshold_ == 0) {
 		enabled_ = false;
 	}
 
-	if (password_.empty()) {
+	if (gateway_host_.empty()) {
+		if (endpoints_.empty()) {
+			enabled_ = false;
+		}
+
+		if (username_.empty()) {
+			enabled_ = false;
+		}
+
+		if (password_.empty()) {
+			enabled_ = false;
+		}
+	} else if (!peer::valid_name(sensor_name_.c_str(), sensor_name_.length())) {
+		logger_.err(F("Sensor name is not valid to send to a gateway"));
 		enabled_ = false;
 	}
 
@@ -81,9 +310,19 @@ void Report::config() {
 		logger_.info(F("Reporting %s"), enabled_ ? F("enabled") : F("disabled"));
 	}
 
-	if (enabled_) {
+	if (enabled_ && !gateway_host_.empty()) {
+		/* Any local port, acknowledgements are sent back to it */
+		gateway_udp_.begin(0);
+		logger_.info(F("Sending readings to gateway %s:%u"), gateway_host_.c_str(), gateway_port_);
+	} else if (enabled_) {
 #ifdef ARDUINO_ARCH_ESP8266
-		if (url_.rfind(uuid::read_flash_string(F("https://")), 0) == 0) {
+		bool tls = false;
+
+		for (const auto &endpoint : endpoints_) {
+			tls |= endpoint.tls;
+		}
+
+		if (tls) {
 			if (!tls_loaded_) {
 				tls_client_.setBufferSizes(512, 512);
 				tls_client_.setSSLVersion(BR_TLS12);
@@ -92,209 +331,1495 @@ void Report::config() {
 				int certs = tls_certs_.initCertStore(app::FS, PSTR("/certs.idx"), PSTR("/certs.ar"));
 				tls_client_.setCertStore(&tls_certs_);
 				logger_.info(F("Loaded CA certificates: %u"), certs);
+				BootTiming::mark(BootPhase::CA_CERTS);
 
 				tls_loaded_ = true;
 			}
+		}
+#endif
+		size_t index = 0;
+
+		for (size_t i = 0; i < endpoints_.size(); i++) {
+			if (endpoints_[i].url == current_url) {
+				index = i;
+				break;
+			}
+		}
 
-			conn_client_ = &tls_client_;
-		} else {
-			conn_client_ = &tcp_client_;
+		use_endpoint(index);
+	}
+
+	disconnect();
+	state_ = UploadState::IDLE;
+	retry_wait_ms_ = 0;
+
+	/* u=&p=&n=&q=1234567890 */
+	size_t prefix_length = 11 + 10 + url_encoded_length(username_) + url_encoded_length(password_)
+		+ url_encoded_length(sensor_name_)
+		+ (latency_ ? LatencyTracer::TEXT_LENGTH : 0);
+
+	live_text_limit_ = prefix_length < MAXIMUM_UPLOAD_BYTES ? MAXIMUM_UPLOAD_BYTES - prefix_length : 0;
+	live_text_.reserve(live_text_limit_ + RECORD_TEXT_LENGTH);
+	live_text_.remove(0);
+	live_text_count_ = 0;
+
+	/* The format may have changed, wait for the next live batch */
+	live_text_valid_ = false;
+}
+
+bool Report::parse_url(UploadEndpoint &endpoint) {
+	const std::string &url = endpoint.url;
+	size_t pos;
+
+	if (url.rfind(uuid::read_flash_string(F("https://")), 0) == 0) {
+		endpoint.tls = true;
+		endpoint.port = 443;
+		pos = 8;
+	} else if (url.rfind(uuid::read_flash_string(F("http://")), 0) == 0) {
+		endpoint.tls = false;
+		endpoint.port = 80;
+		pos = 7;
+	} else {
+		return false;
+	}
+
+	size_t path_pos = url.find('/', pos);
+	std::string authority = url.substr(pos, path_pos == std::string::npos ? std::string::npos : path_pos - pos);
+	size_t port_pos = authority.rfind(':');
+
+	endpoint.path = path_pos == std::string::npos ? "/" : url.substr(path_pos);
+
+	if (port_pos != std::string::npos) {
+		char *end = nullptr;
+		unsigned long port = std::strtoul(authority.c_str() + port_pos + 1, &end, 10);
+
+		if (*end != '\0' || port == 0 || port > UINT16_MAX) {
+			return false;
 		}
+
+		endpoint.host = authority.substr(0, port_pos);
+		endpoint.port = port;
+	} else {
+		endpoint.host = authority;
+	}
+
+	return !endpoint.host.empty();
+}
+
+void Report::use_endpoint(size_t index) {
+	endpoint_ = index;
+
+#ifdef ARDUINO_ARCH_ESP8266
+	conn_client_ = endpoints_[endpoint_].tls ? &tls_client_ : &tcp_client_;
 #endif
+}
+
+bool Report::endpoint_down(const UploadEndpoint &endpoint) const {
+	return endpoint.failures > 0 && ::millis() - endpoint.failed_ms < ENDPOINT_RETRY_MS;
+}
+
+/* Time until a failed endpoint can be used for an upload again */
+uint32_t Report::endpoint_retry_ms(const UploadEndpoint &endpoint) const {
+	return endpoint_down(endpoint) ? ENDPOINT_RETRY_MS - (::millis() - endpoint.failed_ms) : 0;
+}
+
+/* Time until the next upload attempt is allowed after a failure */
+uint32_t Report::retry_ms() const {
+	uint32_t elapsed_ms = ::millis() - retry_start_ms_;
+
+	return elapsed_ms < retry_wait_ms_ ? retry_wait_ms_ - elapsed_ms : 0;
+}
+
+unsigned long Report::uploads() const {
+	unsigned long total = 0;
+
+	for (const auto &endpoint : endpoints_) {
+		total += endpoint.uploads;
 	}
 
-	if (state_ > UploadState::CONNECT && state_ < UploadState::CLEANUP) {
-		http_client_.end();
+	return total;
+}
+
+unsigned long Report::upload_errors() const {
+	unsigned long total = 0;
+
+	for (const auto &endpoint : endpoints_) {
+		total += endpoint.errors;
 	}
-	state_ = UploadState::IDLE;
 
-	http_client_.setReuse(true);
-	http_client_.setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
-	http_client_.setTimeout(HTTP_TIMEOUT_MS);
+	return total;
+}
+
+/*
+ * Select the healthy endpoint with the lowest round trip time, with a small
+ * preference for endpoints earlier in the list. Endpoints that have not been
+ * used yet have no round trip time, so they're only chosen when there's no
+ * healthy endpoint that has been used (e.g. for failover). Endpoints that
+ * have failed can be used again after ENDPOINT_RETRY_MS, by the next upload
+ * (there's no separate probe). If there are no healthy endpoints and any is
+ * true, use the endpoint that failed longest ago.
+ */
+bool Report::select_endpoint(bool any) {
+	size_t best = endpoints_.size();
+	uint32_t best_score = 0;
+
+	for (size_t i = 0; i < endpoints_.size(); i++) {
+		const UploadEndpoint &endpoint = endpoints_[i];
+
+		if (endpoint_down(endpoint)) {
+			continue;
+		}
+
+		uint32_t score = (endpoint.uploads != 0 ? endpoint.rtt_ms : ENDPOINT_UNMEASURED_RTT_MS)
+			+ i * ENDPOINT_PREFERENCE_MS;
+
+		if (best == endpoints_.size() || score < best_score) {
+			best = i;
+			best_score = score;
+		}
+	}
+
+	if (best == endpoints_.size()) {
+		if (!any) {
+			return false;
+		}
+
+		for (size_t i = 0; i < endpoints_.size(); i++) {
+			if (best == endpoints_.size()
+					|| ::millis() - endpoints_[i].failed_ms > ::millis() - endpoints_[best].failed_ms) {
+				best = i;
+			}
+		}
+	}
+
+	if (best != endpoint_) {
+		logger_.notice(F("Uploading to %s"), endpoints_[best].url.c_str());
+		conn_client_->stop();
+		use_endpoint(best);
+	}
+
+	return true;
+}
+
+void Report::endpoint_success(const UploadBatch &batch) {
+	UploadEndpoint &endpoint = endpoints_[endpoint_];
+	uint32_t rtt_ms = ::millis() - batch.sent_ms;
+
+	endpoint.rtt_ms = endpoint.uploads == 0 ? rtt_ms : (endpoint.rtt_ms * 7 + rtt_ms) / 8;
+	endpoint.failure_rate -= endpoint.failure_rate / 8;
+	endpoint.failures = 0;
+	endpoint.uploads++;
+	retry_wait_ms_ = 0;
+}
+
+/* Returns true if there's another healthy endpoint to use immediately */
+bool Report::endpoint_failure() {
+	UploadEndpoint &endpoint = endpoints_[endpoint_];
+
+	endpoint.failure_rate += (UINT8_MAX - endpoint.failure_rate + 7) / 8;
+	if (endpoint.failures < UINT8_MAX) {
+		endpoint.failures++;
+	}
+	endpoint.failed_ms = ::millis();
+	endpoint.errors++;
+
+	/* Fail over immediately if there's another healthy endpoint */
+	if (endpoints_.size() > 1 && select_endpoint(false)) {
+		retry_due_ = true;
+		return true;
+	}
+
+	return false;
 }
 
-void Report::add(uint32_t timestamp, float temperature_c, float relative_humidity_pc, float co2_ppm) {
-	if (timestamp < 19035 * 86400) {
+void Report::disconnect() {
+	if (conn_client_) {
+		conn_client_->stop();
+	}
+
+	batches_.clear();
+	peer_id_sent_ = 0;
+	gateway_waiting_ = false;
+}
+
+void Report::add(uint32_t timestamp, float temperature_c, float relative_humidity_pc, float co2_ppm,
+		uint32_t ready_ms, uint32_t read_ms) {
+	if (timestamp < MINIMUM_TIMESTAMP) {
 		return;
 	}
 
-	if (!readings_.empty()) {
-		if (readings_.back().timestamp >= timestamp) {
-			logger_.trace(F("Ignoring old reading at %u, before %u"), timestamp, readings_.back().timestamp);
-			return;
+	check_clock(timestamp);
+	tracer_.start(timestamp, ready_ms, read_ms);
+
+	Reading reading{timestamp, temperature_c, relative_humidity_pc, co2_ppm};
+
+	if (aggregate_s_ == 0) {
+		store(reading);
+		return;
+	}
+
+	uint32_t start = timestamp - timestamp % aggregate_s_;
+
+	if (!aggregator_.empty() && aggregator_.start() != start) {
+		flush_aggregate();
+	}
+
+	if (aggregator_.empty()) {
+		aggregator_.reset(start);
+	}
+
+	aggregator_.add(reading);
+	logger_.trace(F("Aggregate reading %u at %u"), aggregator_.count(), timestamp);
+}
+
+void Report::check_clock(uint32_t timestamp) {
+	uint32_t now_ms = ::millis();
+
+	if (clock_ts_ != 0) {
+		uint32_t expected = clock_ts_ + (now_ms - clock_ms_ + 500) / 1000;
+		int32_t offset = static_cast<int32_t>(timestamp - expected);
+
+		if (offset > CLOCK_STEP_TOLERANCE_S || offset < -CLOCK_STEP_TOLERANCE_S) {
+			logger_.warning(F("Clock stepped by %lds, adjusting %u stored readings"),
+				static_cast<long>(offset), readings_.size());
+			rebase(offset);
 		}
 	}
 
-	while (readings_.size() >= MAXIMUM_STORE_READINGS) {
-		if (!overflow_) {
-			logger_.alert(F("Reading storage overflow, discarding old readings"));
-			overflow_ = true;
+	clock_ts_ = timestamp;
+	clock_ms_ = now_ms;
+}
+
+void Report::rebase(int32_t offset) {
+	flush_aggregate();
+
+	/*
+	 * Batches that have already been encoded keep their payload and sequence
+	 * number so that a retry is identical to the original request. Only the
+	 * range of readings they cover is moved with the store.
+	 */
+	for (auto &batch : batches_) {
+		if (batch.lane != UploadLane::PEER) {
+			batch.ts_first += offset;
+			batch.ts_last += offset;
 		}
+	}
 
-		logger_.trace(F("Discard reading from %u"), readings_.front().timestamp);
-		readings_.pop_front();
+	live_text_.remove(0);
+	live_text_count_ = 0;
+
+	for (auto &reading : readings_) {
+		reading.timestamp += offset;
+	}
+
+	for (auto &summary : summaries_) {
+		summary.rebase(offset);
+	}
+
+	if (live_ts_last_ != 0) {
+		live_ts_last_ += offset;
+	}
+
+	if (gateway_waiting_) {
+		gateway_ts_last_ += offset;
+	}
+
+	/* The readings have changed so they can't be sent again as the same packet */
+	gateway_ts_first_ = 0;
+
+	tracer_.rebase(offset);
+
+	/* Readings encoded later are marked with the adjustment that was made */
+	for (auto &clock_adjustment : clock_adjustments_) {
+		clock_adjustment.ts_last += offset;
 	}
 
-	readings_.emplace_back(timestamp, temperature_c, relative_humidity_pc, co2_ppm);
-	logger_.trace(F("Add reading %u at %u"), readings_.size(), timestamp);
+	if (!readings_.empty()) {
+		if (clock_adjustments_.size() >= MAXIMUM_CLOCK_ADJUSTMENTS) {
+			clock_adjustments_.erase(clock_adjustments_.begin());
+		}
+
+		clock_adjustments_.push_back({readings_.back().timestamp, offset});
+	}
 
-	upload(true);
+	clock_steps_++;
+	clock_repairs_ += readings_.size();
 }
 
-void Report::upload(bool begin) {
-	switch (state_) {
-	case UploadState::IDLE:
-		if (begin && enabled_ && readings_.size() >= threshold_) {
-			state_ = UploadState::CONNECT;
+/* Total adjustment that has been made to the timestamp of a stored reading */
+int32_t Report::adjustment(uint32_t timestamp) const {
+	int32_t offset = 0;
+
+	for (const auto &clock_adjustment : clock_adjustments_) {
+		if (timestamp <= clock_adjustment.ts_last) {
+			offset += clock_adjustment.offset;
 		}
-		break;
+	}
 
-	case UploadState::CONNECT:
-		http_client_.begin(*conn_client_, url_.c_str());
-		state_ = UploadState::SEND;
-		break;
+	return offset;
+}
 
-	case UploadState::SEND:
-		{
-			String payload(static_cast<char*>(nullptr));
-			size_t count = 0;
-
-			payload.reserve(MAXIMUM_UPLOAD_BYTES);
-
-			// TODO urlencode values
-			payload.concat(F("u="));
-			payload.concat(username_.c_str());
-			payload.concat(F("&p="));
-			payload.concat(password_.c_str());
-			payload.concat(F("&n="));
-			payload.concat(sensor_name_.c_str());
-
-			upload_ts_first_ = 0;
-			upload_ts_last_ = 0;
-			for (const auto &reading : readings_) {
-				String text(static_cast<char*>(nullptr));
-				std::vector<char> value(16);
-				int len;
-
-				text.reserve(64);
-
-				len = snprintf_P(value.data(), value.size(), PSTR("&s=%u"), reading.timestamp);
-				if (len < 0 || len >= (int)value.size()) {
-					break;
-				}
+void Report::flush_aggregate() {
+	if (aggregator_.empty()) {
+		return;
+	}
 
-				text.concat(value.data());
+	ReadingSummary summary = aggregator_.summary(aggregate_s_);
 
-				if (reading.temperature_c != Reading::TEMP_NAN) {
-					len = snprintf_P(value.data(), value.size(), PSTR("&t=%d.%02u"),
-							reading.temperature_c / Reading::TEMP_DIV,
-							(std::abs(reading.temperature_c) % Reading::TEMP_DIV) * Reading::TEMP_MUL);
-					if (len < 0 || len >= (int)value.size()) {
-						break;
-					}
+	store(aggregator_.mean(), &summary);
+	aggregator_.reset(0);
+}
 
-					text.concat(value.data());
-				} else {
-					text.concat(F("&t="));
-				}
+/*
+ * Size the store from the configured capacity or the available memory. The
+ * store is allocated here so that it won't need more memory during an outage.
+ * A configured capacity is limited to what will fit in memory.
+ *
+ * A gateway keeps readings from peers separately, using half of the memory
+ * that is available to the store.
+ */
+void Report::resize() {
+	size_t reading_bytes = sizeof(Reading) + (aggregate_s_ != 0 ? sizeof(ReadingSummary) : 0);
+	/* Memory used by the existing store is available to the new one */
+	size_t free_bytes = ESP.getFreeHeap() + readings_.capacity() * sizeof(Reading)
+		+ summaries_.capacity() * sizeof(ReadingSummary) + peer_readings_.capacity() * sizeof(PeerReading);
 
-				if (reading.relative_humidity_pc != Reading::RHUM_NAN) {
-					len = snprintf_P(value.data(), value.size(), PSTR("&h=%u.%02u"),
-							reading.relative_humidity_pc / Reading::RHUM_DIV,
-							(reading.relative_humidity_pc % Reading::RHUM_DIV) * Reading::RHUM_MUL);
-					if (len < 0 || len >= (int)value.size()) {
-						break;
-					}
+#ifdef ARDUINO_ARCH_ESP8266
+	/*
+	 * BearSSL allocates its buffers when connecting, so leave room for them
+	 * (unless they're already allocated for the current connection)
+	 */
+	bool tls = false;
 
+	for (const auto &endpoint : endpoints_) {
+		tls |= endpoint.tls;
+	}
 
-					text.concat(value.data());
-				} else {
-					text.concat(F("&h="));
-				}
+	if (tls && !(conn_client_ == &tls_client_ && tls_client_.connected())) {
+		free_bytes -= std::min(free_bytes, TLS_RESERVE_BYTES);
+	}
+#endif
 
-				if (reading.co2_ppm != Reading::CO2_NAN) {
-					len = snprintf_P(value.data(), value.size(), PSTR("&c=%u.%02u"),
-							reading.co2_ppm / Reading::CO2_DIV,
-							(reading.co2_ppm % Reading::CO2_DIV) * Reading::CO2_MUL);
-					if (len < 0 || len >= (int)value.size()) {
-						break;
-					}
-
-					text.concat(value.data());
-				} else {
-					text.concat(F("&c="));
-				}
+	size_t peer_bytes = gateway_server_ ? free_bytes / 100 * memory_pc_ / 2 : 0;
+	size_t limit = (free_bytes / 100 * (capacity_config_ != 0 ? MAXIMUM_STORE_MEMORY_PC : memory_pc_) - peer_bytes)
+		/ reading_bytes;
+	size_t capacity = limit;
+	size_t peer_capacity = 0;
 
-				if (count > 0 && payload.length() + text.length() > MAXIMUM_UPLOAD_BYTES) {
-					break;
-				}
+	if (capacity_config_ != 0) {
+		capacity = capacity_config_;
 
-				count++;
-				if (upload_ts_first_ == 0) {
-					upload_ts_first_ = reading.timestamp;
-				}
-				upload_ts_last_ = reading.timestamp;
+		if (capacity > limit) {
+			logger_.warning(F("Reading storage capacity %u is too large for the available memory, using %u"),
+				capacity, limit);
+			capacity = limit;
+		}
+	}
 
-				payload.concat(text);
-			}
+	capacity = std::max(MINIMUM_STORE_READINGS, std::min(MAXIMUM_STORE_READINGS, capacity));
 
-			if (upload_ts_first_ == 0) {
-				logger_.err(F("Failed to encode any readings"));
-				state_ = UploadState::IDLE;
-			} else {
-				logger_.debug(F("Uploading %lu readings from %u to %u (%u bytes)"),
-					static_cast<unsigned long>(count), upload_ts_first_, upload_ts_last_, payload.length());
-				http_client_.addHeader(F("Content-Type"), F("application/x-www-form-urlencoded"));
-
-				int response = http_client_.POST(payload);
-				if (response == 200) {
-					logger_.trace(F("HTTP POST %u"), response);
-					state_ = UploadState::RECEIVE;
-				} else if (response >= 0) {
-					logger_.err(F("Upload failure for %u to %u, received HTTP response code %d"),
-						upload_ts_first_, upload_ts_last_, response);
-					http_client_.end();
-					state_ = UploadState::IDLE;
-				} else {
-					logger_.err(F("Upload failure for %u to %u: %s"),
-						upload_ts_first_, upload_ts_last_,
-						HTTPClient::errorToString(response).c_str());
-					http_client_.end();
-					state_ = UploadState::IDLE;
-				}
-			}
+	if (gateway_server_) {
+		peer_capacity = std::max(MINIMUM_STORE_READINGS,
+			std::min(MAXIMUM_STORE_READINGS, peer_bytes / sizeof(PeerReading)));
+	} else if (!peer_readings_.empty()) {
+		/* Readings from peers are kept until they have been uploaded */
+		peer_capacity = peer_readings_.capacity();
+	}
+
+	while (true) {
+		while (readings_.size() > capacity) {
+			discard_oldest();
 		}
-		break;
 
-	case UploadState::RECEIVE:
-		if (http_client_.getString() == F("OK\n")) {
-			logger_.trace(F("Upload successful"));
-			state_ = UploadState::CLEANUP;
-		} else {
-			logger_.err(F("Upload failure for %u to %u, received unexpected response"),
-				upload_ts_first_, upload_ts_last_);
-			state_ = UploadState::IDLE;
+		while (peer_readings_.size() > peer_capacity) {
+			discard_peer_oldest();
 		}
-		http_client_.end();
-		break;
 
-	case UploadState::CLEANUP:
-		size_t before = readings_.size();
+		/* Summaries are kept until their readings are removed */
+		size_t summary_capacity = aggregate_s_ != 0 || !summaries_.empty() ? capacity : 0;
 
-		while (!readings_.empty() && readings_.front().timestamp <= upload_ts_last_) {
-			readings_.pop_front();
+		if (peer_readings_.allocate(peer_capacity) && summaries_.allocate(summary_capacity)
+				&& readings_.allocate(capacity)) {
+			break;
 		}
 
-		logger_.trace(F("Removed %lu readings"), static_cast<unsigned long>(before - readings_.size()));
-		state_ = UploadState::IDLE;
-		break;
-	}
-}
+		if (capacity == MINIMUM_STORE_READINGS && peer_capacity <= MINIMUM_STORE_READINGS) {
+			logger_.crit(F("Unable to allocate reading storage for %u readings"), capacity + peer_capacity);
+			break;
+		}
+
+		capacity = std::max(MINIMUM_STORE_READINGS, capacity / 2);
+
+		if (peer_capacity != 0) {
+			peer_capacity = std::max(MINIMUM_STORE_READINGS, peer_capacity / 2);
+		}
+	}
+
+	if (readings_.capacity() != capacity_) {
+		capacity_ = readings_.capacity();
+		logger_.info(F("Reading storage capacity %u%S (%u bytes free)"), capacity_,
+			capacity_config_ != 0 ? F("") : F(" from available memory"), ESP.getFreeHeap());
+	}
+
+	if (peer_readings_.capacity() != peer_capacity_) {
+		peer_capacity_ = peer_readings_.capacity();
+		logger_.info(F("Peer reading storage capacity %u (%u bytes free)"), peer_capacity_, ESP.getFreeHeap());
+	}
+}
+
+void Report::discard_oldest() {
+	if (!overflow_) {
+		logger_.alert(F("Reading storage overflow, discarding old readings"));
+		overflow_ = true;
+	}
+
+	logger_.trace(F("Discard reading from %u"), readings_.front().timestamp);
+	Counters::increment(Counter::OVERFLOW_DROPS);
+	discard_batches(readings_.front().timestamp);
+
+	while (!summaries_.empty() && summaries_.front().timestamp() <= readings_.front().timestamp) {
+		summaries_.pop_front();
+	}
+
+	readings_.pop_front();
+}
+
+void Report::discard_peer_oldest() {
+	if (!peer_overflow_) {
+		logger_.alert(F("Peer reading storage overflow, discarding old readings"));
+		peer_overflow_ = true;
+	}
+
+	Counters::increment(Counter::OVERFLOW_DROPS);
+	discard_peer_batches(peer_readings_.front().id);
+	peer_readings_.pop_front();
+}
+
+void Report::store(const Reading &reading, const ReadingSummary *summary) {
+	if (!readings_.empty()) {
+		if (readings_.back().timestamp >= reading.timestamp) {
+			logger_.trace(F("Ignoring old reading at %u, before %u"), reading.timestamp, readings_.back().timestamp);
+			return;
+		}
+	}
+
+	if (capacity_ == 0) {
+		resize();
+
+		if (capacity_ == 0) {
+			return;
+		}
+	}
+
+	while (readings_.full()) {
+		discard_oldest();
+	}
+
+	readings_.push_back(reading);
+	if (summary && !summaries_.full()) {
+		summaries_.push_back(*summary);
+	}
+	tracer_.store(reading.timestamp, summary ? reading.timestamp + summary->window_s - 1 : reading.timestamp,
+		reading.timestamp);
+	encode_live(reading, summary);
+	logger_.trace(F("Add reading %u at %u"), readings_.size(), reading.timestamp);
+
+	if (live_pending() >= threshold_) {
+		live_due_ = true;
+	}
+
+	if (!batches_.empty()) {
+		retry_due_ = true;
+	}
+
+	upload();
+}
+
+bool Report::add_peer(const std::string &name, uint32_t sequence, const uint8_t *data, size_t count) {
+	size_t index = 0;
+
+	while (index < peers_.size() && peers_[index].name != name) {
+		index++;
+	}
+
+	if (index == peers_.size()) {
+		if (peers_.size() >= MAXIMUM_PEERS) {
+			logger_.warning(F("Too many peers, ignoring readings from %s"), name.c_str());
+			return false;
+		}
+
+		logger_.info(F("New peer %s"), name.c_str());
+		peers_.push_back({name, 0, 0, 0});
+	}
+
+	PeerDevice &device = peers_[index];
+
+	/*
+	 * Already received, but the acknowledgement was lost. Peers send the same
+	 * packet again with the same sequence number until it is acknowledged.
+	 */
+	if (sequence == device.sequence) {
+		logger_.trace(F("Ignoring repeated readings from peer %s (sequence %u)"), name.c_str(), sequence);
+		return true;
+	}
+
+	if (peer_readings_.capacity() == 0) {
+		resize();
+
+		if (peer_readings_.capacity() == 0) {
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++, data += Reading::PACKED_BYTES) {
+		Reading reading = Reading::unpack(data);
+
+		if (reading.timestamp < MINIMUM_TIMESTAMP) {
+			continue;
+		}
+
+		while (peer_readings_.full()) {
+			discard_peer_oldest();
+		}
+
+		peer_readings_.push_back({++peer_id_, static_cast<uint8_t>(index), reading});
+		device.timestamp = reading.timestamp;
+		device.readings++;
+	}
+
+	device.sequence = sequence;
+
+	logger_.trace(F("Add %lu readings from peer %s (sequence %u)"),
+		static_cast<unsigned long>(count), name.c_str(), sequence);
+
+	upload();
+	return true;
+}
+
+std::pair<Report::reading_iterator, Report::reading_iterator> Report::find(uint32_t first, uint32_t last) const {
+	auto begin = lower_bound(readings_.cbegin(), readings_.cend(), first);
+
+	return {begin, upper_bound(begin, readings_.cend(), last)};
+}
+
+size_t Report::live_pending() const {
+	return readings_.end() - upper_bound(readings_.begin(), readings_.end(), live_ts_last_);
+}
+
+Report::peer_iterator Report::peer_begin(uint32_t id) const {
+	return std::upper_bound(peer_readings_.cbegin(), peer_readings_.cend(), id,
+		[] (uint32_t value, const PeerReading &peer_reading) { return value < peer_reading.id; });
+}
+
+size_t Report::peer_pending() const {
+	return peer_readings_.cend() - peer_begin(peer_id_sent_);
+}
+
+/* Upload early if the oldest reading that hasn't been sent is too old */
+void Report::check_latency() {
+	if (max_latency_s_ == 0 || live_due_) {
+		return;
+	}
+
+	auto oldest = upper_bound(readings_.cbegin(), readings_.cend(), live_ts_last_);
+	time_t now = ::time(nullptr);
+
+	if (oldest != readings_.cend() && now >= static_cast<time_t>(oldest->timestamp + max_latency_s_)) {
+		logger_.trace(F("Reading at %u has waited more than %us"), oldest->timestamp, max_latency_s_);
+		live_due_ = true;
+	}
+}
+
+void Report::backfill_range(reading_iterator &begin, reading_iterator &end) const {
+	begin = readings_.cbegin();
+	end = upper_bound(begin, readings_.cend(), live_ts_last_);
+
+	/* Batches in flight cover disjoint ranges, continue after them */
+	for (const auto &batch : batches_) {
+		if (batch.lane == UploadLane::BACKFILL) {
+			begin = upper_bound(begin, end, batch.ts_last);
+		}
+	}
+
+	for (const auto &batch : batches_) {
+		if (batch.lane == UploadLane::LIVE) {
+			end = lower_bound(begin, end, batch.ts_first);
+		}
+	}
+}
+
+bool Report::next_lane(UploadLane &lane) const {
+	if (live_due_) {
+		lane = UploadLane::LIVE;
+		return true;
+	}
+
+	/* Combine readings from peers into batches of at least the threshold */
+	if (peer_pending() >= std::max(static_cast<size_t>(1), threshold_)) {
+		lane = UploadLane::PEER;
+		return true;
+	}
+
+	if (backfill_ready_) {
+		reading_iterator begin, end;
+
+		backfill_range(begin, end);
+
+		if (begin != end) {
+			lane = UploadLane::BACKFILL;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint32_t Report::next_sequence() {
+	return sequence_source_ ? sequence_source_() : Counters::next_sequence();
+}
+
+static inline bool url_unreserved(char c) {
+	return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')
+		|| c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+size_t Report::url_encoded_length(const std::string &value) {
+	size_t length = 0;
+
+	for (char c : value) {
+		length += url_unreserved(c) ? 1 : 3;
+	}
+
+	return length;
+}
+
+static inline char *url_encode_char(char *text, char c) {
+	static const char hex[] = "0123456789ABCDEF";
+
+	if (url_unreserved(c)) {
+		*text++ = c;
+	} else {
+		*text++ = '%';
+		*text++ = hex[static_cast<uint8_t>(c) >> 4];
+		*text++ = hex[static_cast<uint8_t>(c) & 0xF];
+	}
+
+	return text;
+}
+
+/*
+ * Append the form encoding of value to text, which must have space for
+ * url_encoded_length(value) characters. Returns the end of the text (not
+ * terminated).
+ */
+char *Report::url_encode(char *text, const std::string &value) {
+	for (char c : value) {
+		text = url_encode_char(text, c);
+	}
+
+	return text;
+}
+
+void Report::url_encode(String &payload, const std::string &value) {
+	for (char c : value) {
+		char text[3];
+
+		payload.concat(text, url_encode_char(text, c) - text);
+	}
+}
+
+char *Report::format_record(char *text, const Reading &reading, const ReadingSummary *summary,
+		int32_t adjustment) const {
+	text = reading.format_text(text);
+
+	if (adjustment != 0) {
+		text = Reading::format_key(text, 'o');
+
+		if (adjustment < 0) {
+			*text++ = '-';
+		}
+
+		text = Reading::format_decimal(text, adjustment < 0
+			? -static_cast<uint32_t>(adjustment) : static_cast<uint32_t>(adjustment));
+	}
+
+	if (derived_) {
+		text = psychrometrics::format_text(reading, text);
+	}
+
+	if (summary) {
+		text = summary->format_text(text, quantiles_);
+	}
+
+	return text;
+}
+
+void Report::encode_live(const Reading &reading, const ReadingSummary *summary) {
+	if (!live_text_valid_) {
+		return;
+	}
+
+	char text[RECORD_TEXT_LENGTH + 1];
+	char *text_end = format_record(text, reading, summary);
+	size_t length = text_end - text;
+
+	*text_end = '\0';
+
+	/* Keep only the newest readings that will fit in the next live batch */
+	while (live_text_count_ > 0
+			&& (live_text_count_ >= threshold_ || live_text_.length() + length > live_text_limit_)) {
+		const char *next = ::strstr(live_text_.c_str() + 1, "&s=");
+
+		if (next == nullptr) {
+			live_text_.remove(0);
+			live_text_count_ = 0;
+			break;
+		}
+
+		live_text_.remove(0, next - live_text_.c_str());
+		live_text_first_ = std::strtoul(live_text_.c_str() + 3, nullptr, 10);
+		live_text_count_--;
+	}
+
+	if (live_text_count_ == 0) {
+		live_text_first_ = reading.timestamp;
+	}
+
+	live_text_.concat(text);
+	live_text_last_ = reading.timestamp;
+	live_text_count_++;
+}
+
+bool Report::encode_batch(UploadLane lane, UploadBatch &batch) {
+	reading_iterator begin = readings_.cbegin();
+	reading_iterator end = readings_.cend();
+	size_t limit = 0;
+
+	if (lane == UploadLane::LIVE) {
+		/* Anything older than the threshold will be backfilled */
+		live_due_ = false;
+		begin = end - std::min(live_pending(), threshold_);
+	} else if (lane == UploadLane::BACKFILL) {
+		backfill_range(begin, end);
+		limit = backfill_batch_;
+	} else {
+		begin = end;
+	}
+
+	if (lane != UploadLane::PEER && begin == end) {
+		return false;
+	}
+
+	String payload(static_cast<char*>(nullptr));
+
+	batch.sequence = next_sequence();
+	batch.ts_first = 0;
+	batch.ts_last = 0;
+	batch.count = 0;
+	batch.lane = lane;
+	batch.sent = false;
+
+	payload.reserve(MAXIMUM_UPLOAD_BYTES);
+
+	payload.concat(F("u="));
+	url_encode(payload, username_);
+	payload.concat(F("&p="));
+	url_encode(payload, password_);
+	payload.concat(F("&n="));
+	url_encode(payload, sensor_name_);
+	payload.concat(F("&q="));
+	payload.concat(String(batch.sequence));
+
+	if (latency_ && tracer_.count() > 0) {
+		char text[LatencyTracer::TEXT_LENGTH + 1];
+
+		*tracer_.format_text(text) = '\0';
+		payload.concat(text);
+	}
+
+	if (lane == UploadLane::PEER) {
+		encode_peers(batch, payload);
+	} else if (lane == UploadLane::LIVE && live_text_valid_ && live_text_count_ == static_cast<size_t>(end - begin)
+			&& live_text_first_ == begin->timestamp) {
+		/* Already encoded as each reading was added */
+		payload.concat(live_text_);
+		batch.ts_first = live_text_first_;
+		batch.ts_last = live_text_last_;
+		batch.count = live_text_count_;
+	} else {
+		auto summary = lower_bound(summaries_.cbegin(), summaries_.cend(), begin->timestamp);
+
+		for (auto it = begin; it != end && (limit == 0 || batch.count < limit); ++it) {
+			const auto &reading = *it;
+			char text[RECORD_TEXT_LENGTH + 1];
+
+			while (summary != summaries_.cend() && summary->timestamp() < reading.timestamp) {
+				++summary;
+			}
+
+			char *text_end = format_record(text, reading,
+				summary != summaries_.cend() && summary->timestamp() == reading.timestamp ? &*summary : nullptr,
+				adjustment(reading.timestamp));
+
+			*text_end = '\0';
+
+			if (batch.count > 0 && payload.length() + (text_end - text) > MAXIMUM_UPLOAD_BYTES) {
+				break;
+			}
+
+			batch.count++;
+			if (batch.ts_first == 0) {
+				batch.ts_first = reading.timestamp;
+			}
+			batch.ts_last = reading.timestamp;
+
+			payload.concat(text);
+		}
+	}
+
+	if (lane == UploadLane::LIVE) {
+		live_text_.remove(0);
+		live_text_count_ = 0;
+		live_text_valid_ = true;
+	}
+
+	if (batch.count == 0) {
+		logger_.err(F("Failed to encode any readings"));
+		return false;
+	}
+
+	batch.payload = std::move(payload);
+
+	logger_.debug(F("Uploading %lu %S readings from %u to %u (%u bytes, sequence %u)"),
+		static_cast<unsigned long>(batch.count),
+		lane == UploadLane::LIVE ? F("live") : (lane == UploadLane::PEER ? F("peer") : F("backfill")),
+		batch.ts_first, batch.ts_last, batch.payload.length(), batch.sequence);
+
+	if (lane == UploadLane::LIVE) {
+		live_ts_last_ = std::max(live_ts_last_, batch.ts_last);
+	}
+
+	if (lane != UploadLane::PEER) {
+		tracer_.mark(batch.ts_first, batch.ts_last, TraceStage::ENCODED);
+	}
+
+	return true;
+}
+
+void Report::encode_peers(UploadBatch &batch, String &payload) {
+	size_t peer = SIZE_MAX;
+
+	for (auto it = peer_begin(peer_id_sent_); it != peer_readings_.cend(); ++it) {
+		char text[3 + 3 * peer::MAXIMUM_NAME_LENGTH + RECORD_TEXT_LENGTH + 1];
+		char *text_end = text;
+
+		/* Records that follow a name belong to that peer */
+		if (it->peer != peer) {
+			const std::string &name = peers_[it->peer].name;
+
+			*text_end++ = '&';
+			*text_end++ = 'n';
+			*text_end++ = '=';
+			text_end = url_encode(text_end, name);
+		}
+
+		text_end = format_record(text_end, it->reading, nullptr);
+		*text_end = '\0';
+
+		if (batch.count > 0 && payload.length() + (text_end - text) > MAXIMUM_UPLOAD_BYTES) {
+			break;
+		}
+
+		batch.count++;
+		if (batch.ts_first == 0) {
+			batch.ts_first = it->id;
+		}
+		batch.ts_last = it->id;
+		peer = it->peer;
+
+		payload.concat(text);
+	}
+
+	if (batch.count > 0) {
+		peer_id_sent_ = batch.ts_last;
+	}
+}
+
+bool Report::send_request(UploadBatch &batch) {
+	const UploadEndpoint &endpoint = endpoints_[endpoint_];
+	std::vector<char> header(MAXIMUM_HEADER_BYTES);
+	int len = snprintf_P(header.data(), header.size(),
+		PSTR("POST %s HTTP/1.1\r\n"
+			"Host: %s:%u\r\n"
+			"Content-Type: application/x-www-form-urlencoded\r\n"
+			"Content-Length: %u\r\n"
+			"\r\n"),
+		endpoint.path.c_str(), endpoint.host.c_str(), endpoint.port, batch.payload.length());
+
+	if (len < 0 || len >= (int)header.size()) {
+		logger_.err(F("Request header too long"));
+		upload_failed();
+		return false;
+	}
+
+	if (conn_client_->write(reinterpret_cast<const uint8_t*>(header.data()), len) != static_cast<size_t>(len)
+			|| conn_client_->write(reinterpret_cast<const uint8_t*>(batch.payload.c_str()), batch.payload.length()) != batch.payload.length()) {
+		logger_.err(F("Upload failure for %u to %u, unable to send request"), batch.ts_first, batch.ts_last);
+		upload_failed();
+		return false;
+	}
+
+	TrafficChannel channel = endpoint.tls ? TrafficChannel::HTTPS : TrafficChannel::HTTP;
+
+	Traffic::count(channel);
+	Traffic::sent(channel, batch.payload.length(), len);
+
+	batch.sent = true;
+	batch.sent_ms = ::millis();
+
+	if (batch.lane != UploadLane::PEER) {
+		tracer_.mark(batch.ts_first, batch.ts_last, TraceStage::SENT);
+	}
+	return true;
+}
+
+void Report::discard_batches(uint32_t timestamp) {
+	auto it = batches_.begin();
+
+	while (it != batches_.end()) {
+		if (!it->sent && it->lane != UploadLane::PEER && it->ts_first <= timestamp) {
+			logger_.trace(F("Discard encoded batch from %u to %u"), it->ts_first, it->ts_last);
+			it = batches_.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void Report::discard_peer_batches(uint32_t id) {
+	auto it = batches_.begin();
+
+	peer_id_sent_ = 0;
+
+	while (it != batches_.end()) {
+		if (it->lane != UploadLane::PEER) {
+			++it;
+		} else if (!it->sent && it->ts_first <= id) {
+			logger_.trace(F("Discard encoded peer batch from %u to %u"), it->ts_first, it->ts_last);
+			it = batches_.erase(it);
+		} else {
+			peer_id_sent_ = std::max(peer_id_sent_, it->ts_last);
+			++it;
+		}
+	}
+}
+
+void Report::receive_start() {
+	receive_start_ms_ = ::millis();
+	response_state_ = ResponseState::STATUS;
+	response_bytes_ = 0;
+	response_pos_ = 0;
+	response_code_ = -1;
+	response_length_ = -1;
+	response_chunked_ = false;
+	response_body_pos_ = 0;
+	close_ = false;
+}
+
+/* Skip the header name and any spaces before the value */
+static inline const char *header_value(const char *line, size_t name_length) {
+	const char *value = line + name_length;
+
+	while (*value == ' ') {
+		value++;
+	}
+
+	return value;
+}
+
+ResponseResult Report::receive_line() {
+	const UploadBatch &batch = batches_.front();
+	const char *line = response_line_;
+
+	switch (response_state_) {
+	case ResponseState::STATUS:
+		if (::strncmp_P(line, PSTR("HTTP/1."), 7) == 0 && response_pos_ > 9) {
+			response_code_ = ::atoi(line + 9);
+		}
+
+		response_state_ = ResponseState::HEADERS;
+		return ResponseResult::PENDING;
+
+	case ResponseState::HEADERS:
+		break;
+
+	case ResponseState::CHUNK_SIZE:
+		{
+			/* Hexadecimal size, optionally followed by extensions */
+			char *end = nullptr;
+			unsigned long size = std::strtoul(line, &end, 16);
+
+			if (end == line || (*end != '\0' && *end != ';' && *end != ' ')) {
+				logger_.err(F("Upload failure for %u to %u, invalid chunk size"),
+					batch.ts_first, batch.ts_last);
+				return ResponseResult::FAILED;
+			}
+
+			if (size == 0) {
+				response_state_ = ResponseState::TRAILERS;
+			} else if (size > RESPONSE_BODY_LENGTH - response_body_pos_) {
+				logger_.err(F("Upload failure for %u to %u, received unexpected response length"),
+					batch.ts_first, batch.ts_last);
+				return ResponseResult::FAILED;
+			} else {
+				response_chunk_ = size;
+				response_state_ = ResponseState::CHUNK_DATA;
+			}
+		}
+		return ResponseResult::PENDING;
+
+	case ResponseState::CHUNK_END:
+		/* Line ending after the chunk data */
+		if (response_pos_ > 0) {
+			logger_.err(F("Upload failure for %u to %u, invalid chunk"),
+				batch.ts_first, batch.ts_last);
+			return ResponseResult::FAILED;
+		}
+
+		response_state_ = ResponseState::CHUNK_SIZE;
+		return ResponseResult::PENDING;
+
+	case ResponseState::TRAILERS:
+		/* Trailer fields are ignored, the body ends with an empty line */
+		return response_pos_ > 0 ? ResponseResult::PENDING : receive_body();
+
+	case ResponseState::BODY:
+	case ResponseState::CHUNK_DATA:
+		return ResponseResult::PENDING;
+	}
+
+	if (response_pos_ > 0) {
+		if (::strncasecmp_P(line, PSTR("Content-Length:"), 15) == 0) {
+			response_length_ = ::atol(line + 15);
+		} else if (::strncasecmp_P(line, PSTR("Transfer-Encoding:"), 18) == 0) {
+			response_chunked_ = ::strncasecmp_P(header_value(line, 18), PSTR("chunked"), 7) == 0;
+		} else if (::strncasecmp_P(line, PSTR("Connection:"), 11) == 0) {
+			close_ = ::strncasecmp_P(header_value(line, 11), PSTR("close"), 5) == 0;
+		}
+		return ResponseResult::PENDING;
+	}
+
+	/* End of headers, there's no need to read the body of an error response */
+	if (response_code_ != 200) {
+		logger_.err(F("Upload failure for %u to %u, received HTTP response code %d"),
+			batch.ts_first, batch.ts_last, response_code_);
+		return ResponseResult::FAILED;
+	}
+
+	/* Chunked encoding takes precedence over any Content-Length */
+	if (response_chunked_) {
+		response_state_ = ResponseState::CHUNK_SIZE;
+		return ResponseResult::PENDING;
+	}
+
+	if (response_length_ < 0) {
+		logger_.err(F("Upload failure for %u to %u, response has no length"),
+			batch.ts_first, batch.ts_last);
+		return ResponseResult::FAILED;
+	}
+
+	if (response_length_ != RESPONSE_BODY_LENGTH) {
+		logger_.err(F("Upload failure for %u to %u, received unexpected response length %ld"),
+			batch.ts_first, batch.ts_last, response_length_);
+		return ResponseResult::FAILED;
+	}
+
+	response_state_ = ResponseState::BODY;
+	return ResponseResult::PENDING;
+}
+
+ResponseResult Report::receive_body() {
+	const UploadBatch &batch = batches_.front();
+
+	response_body_[response_body_pos_] = '\0';
+
+	if (::strcmp_P(response_body_, PSTR("OK\n"))) {
+		logger_.err(F("Upload failure for %u to %u, received unexpected response"),
+			batch.ts_first, batch.ts_last);
+		return ResponseResult::FAILED;
+	}
+
+	logger_.trace(F("Upload successful for sequence %u"), batch.sequence);
+	return ResponseResult::OK;
+}
+
+ResponseResult Report::receive_response() {
+	const UploadBatch &batch = batches_.front();
+	TrafficChannel channel = endpoints_[endpoint_].tls ? TrafficChannel::HTTPS : TrafficChannel::HTTP;
+
+	/*
+	 * Read one byte at a time so that nothing from the next pipelined
+	 * response is consumed. Only a prefix of each line is kept.
+	 */
+	while (conn_client_->available() > 0) {
+		int c = conn_client_->read();
+
+		if (c < 0) {
+			break;
+		}
+
+		if (response_state_ == ResponseState::BODY || response_state_ == ResponseState::CHUNK_DATA) {
+			Traffic::received(channel, 1, 0);
+		} else {
+			Traffic::received(channel, 0, 1);
+		}
+
+		if (++response_bytes_ > MAXIMUM_RESPONSE_BYTES) {
+			logger_.err(F("Upload failure for %u to %u, response too long"),
+				batch.ts_first, batch.ts_last);
+			return ResponseResult::FAILED;
+		}
+
+		if (response_state_ == ResponseState::BODY) {
+			response_body_[response_body_pos_++] = c;
+
+			if (response_body_pos_ == static_cast<size_t>(response_length_)) {
+				return receive_body();
+			}
+		} else if (response_state_ == ResponseState::CHUNK_DATA) {
+			response_body_[response_body_pos_++] = c;
+
+			if (--response_chunk_ == 0) {
+				response_state_ = ResponseState::CHUNK_END;
+			}
+		} else if (c == '\n') {
+			while (response_pos_ > 0 && ::isspace(response_line_[response_pos_ - 1])) {
+				response_pos_--;
+			}
+			response_line_[response_pos_] = '\0';
+
+			ResponseResult result = receive_line();
+
+			response_pos_ = 0;
+
+			if (result != ResponseResult::PENDING) {
+				return result;
+			}
+		} else if (response_pos_ < RESPONSE_LINE_LENGTH) {
+			response_line_[response_pos_++] = c;
+		}
+	}
+
+	return ResponseResult::PENDING;
+}
+
+void Report::upload_failed() {
+	conn_client_->stop();
+
+	/* Keep the encoded requests to send again */
+	for (auto &batch : batches_) {
+		batch.sent = false;
+	}
+
+	backfill_ready_ = false;
+	state_ = UploadState::IDLE;
+	Counters::increment(Counter::UPLOAD_FAILURES);
+
+	if (!endpoint_failure()) {
+		/* Wait before trying again, instead of connecting on every loop */
+		retry_wait_ms_ = retry_wait_ms_ == 0 ? RETRY_MINIMUM_MS : std::min(RETRY_MAXIMUM_MS, retry_wait_ms_ * 2);
+		retry_start_ms_ = ::millis();
+		logger_.debug(F("Retry upload in %ums"), retry_wait_ms_);
+	}
+}
+
+void Report::upload() {
+	if (!gateway_host_.empty()) {
+		upload_gateway();
+		return;
+	}
+
+	switch (state_) {
+	case UploadState::IDLE:
+		{
+			UploadLane lane;
+
+			if (retry_ms() != 0) {
+				break;
+			}
+
+			if (enabled_ && ((retry_due_ && !batches_.empty()) || next_lane(lane))) {
+				select_endpoint(true);
+				state_ = UploadState::CONNECT;
+			}
+		}
+		break;
+
+	case UploadState::CONNECT:
+		if (!conn_client_->connected()) {
+			const UploadEndpoint &endpoint = endpoints_[endpoint_];
+
+			conn_client_->stop();
+			conn_client_->setTimeout(HTTP_TIMEOUT_MS);
+
+			logger_.trace(F("Connecting to %s:%u"), endpoint.host.c_str(), endpoint.port);
+			if (!conn_client_->connect(endpoint.host.c_str(), endpoint.port)) {
+				logger_.err(F("Upload failure, unable to connect to %s:%u"), endpoint.host.c_str(), endpoint.port);
+				upload_failed();
+				break;
+			}
+
+#ifdef ARDUINO_ARCH_ESP8266
+			if (conn_client_ == &tls_client_) {
+				BootTiming::mark(BootPhase::TLS_HANDSHAKE);
+				Traffic::count(TrafficChannel::TLS_HANDSHAKE);
+			}
+#endif
+		}
+
+		state_ = UploadState::SEND;
+		break;
+
+	case UploadState::SEND:
+		retry_due_ = false;
+
+		for (auto &batch : batches_) {
+			if (!batch.sent) {
+				logger_.debug(F("Uploading %lu readings from %u to %u again (sequence %u)"),
+					static_cast<unsigned long>(batch.count), batch.ts_first, batch.ts_last, batch.sequence);
+
+				if (!send_request(batch)) {
+					break;
+				}
+			}
+		}
+
+		while (state_ == UploadState::SEND && batches_.size() < pipeline_) {
+			UploadLane lane;
+
+			if (!next_lane(lane)) {
+				break;
+			}
+
+			/* Not queued until it's encoded, backfill_range() would include it */
+			UploadBatch batch;
+
+			if (!encode_batch(lane, batch)) {
+				break;
+			}
+
+			batches_.push_back(std::move(batch));
+			send_request(batches_.back());
+		}
+
+		if (state_ != UploadState::SEND) {
+			break;
+		}
+
+		if (batches_.empty()) {
+			state_ = UploadState::IDLE;
+		} else {
+			receive_start();
+			state_ = UploadState::RECEIVE;
+		}
+		break;
+
+	case UploadState::RECEIVE:
+		if (conn_client_->available() > 0) {
+			switch (receive_response()) {
+			case ResponseResult::PENDING:
+				break;
+
+			case ResponseResult::OK:
+				state_ = UploadState::CLEANUP;
+				break;
+
+			case ResponseResult::FAILED:
+				upload_failed();
+				break;
+			}
+		} else if (!conn_client_->connected()) {
+			logger_.err(F("Upload failure for %u to %u, connection closed"),
+				batches_.front().ts_first, batches_.front().ts_last);
+			upload_failed();
+		} else if (::millis() - receive_start_ms_ >= HTTP_TIMEOUT_MS) {
+			logger_.err(F("Upload failure for %u to %u, timeout waiting for response"),
+				batches_.front().ts_first, batches_.front().ts_last);
+			upload_failed();
+		}
+		break;
+
+	case UploadState::CLEANUP:
+		{
+			const UploadBatch &batch = batches_.front();
+
+			if (batch.lane == UploadLane::PEER) {
+				auto begin = peer_begin(batch.ts_first - 1);
+				auto end = peer_begin(batch.ts_last);
+				size_t count = end - begin;
+
+				peer_readings_.erase(begin, end);
+				logger_.trace(F("Removed %lu peer readings"), static_cast<unsigned long>(count));
+			} else {
+				auto begin = lower_bound(readings_.begin(), readings_.end(), batch.ts_first);
+				auto end = upper_bound(begin, readings_.end(), batch.ts_last);
+				size_t count = end - begin;
+
+				readings_.erase(begin, end);
+				summaries_.erase(lower_bound(summaries_.begin(), summaries_.end(), batch.ts_first),
+					upper_bound(summaries_.begin(), summaries_.end(), batch.ts_last));
+				logger_.trace(F("Removed %lu readings"), static_cast<unsigned long>(count));
+				tracer_.mark(batch.ts_first, batch.ts_last, TraceStage::ACKNOWLEDGED);
+			}
+
+			BootTiming::mark(BootPhase::FIRST_UPLOAD);
+			endpoint_success(batch);
+
+			batches_.pop_front();
+
+			/* Continue backfilling older readings until there's a failure */
+			backfill_ready_ = true;
+
+			if (close_) {
+				/* Any remaining batches will need to be sent again */
+				conn_client_->stop();
+
+				for (auto &batch : batches_) {
+					batch.sent = false;
+				}
+
+				retry_due_ = true;
+				state_ = UploadState::IDLE;
+			} else {
+				state_ = UploadState::SEND;
+			}
+		}
+		break;
+	}
+}
+
+void Report::upload_gateway() {
+	if (gateway_waiting_) {
+		if (gateway_udp_.parsePacket() > 0) {
+			uint8_t data[peer::HEADER_BYTES];
+			int length = gateway_udp_.read(data, sizeof(data));
+			uint32_t sequence;
+
+			if (length > 0) {
+				Traffic::received(TrafficChannel::GATEWAY_UPLINK, 0, length);
+			}
+
+			if (length <= 0 || !peer::read_header(data, length, peer::ACK, sequence) || sequence != gateway_sequence_) {
+				return;
+			}
+
+			auto end = upper_bound(readings_.begin(), readings_.end(), gateway_ts_last_);
+			size_t count = end - readings_.begin();
+
+			tracer_.mark(0, gateway_ts_last_, TraceStage::ACKNOWLEDGED);
+
+			readings_.erase(readings_.begin(), end);
+			summaries_.erase(summaries_.begin(), upper_bound(summaries_.begin(), summaries_.end(), gateway_ts_last_));
+			logger_.trace(F("Removed %lu readings"), static_cast<unsigned long>(count));
+			BootTiming::mark(BootPhase::FIRST_UPLOAD);
+
+			gateway_waiting_ = false;
+			gateway_resend_ = false;
+
+			/* Continue sending older readings until there's a failure */
+			retry_due_ = !readings_.empty();
+		} else if (::millis() - gateway_sent_ms_ >= GATEWAY_TIMEOUT_MS) {
+			logger_.err(F("Upload failure, no response from gateway %s:%u"), gateway_host_.c_str(), gateway_port_);
+			Counters::increment(Counter::UPLOAD_FAILURES);
+			gateway_waiting_ = false;
+			gateway_resend_ = true;
+			retry_due_ = false;
+		}
+		return;
+	}
+
+	if (!enabled_ || readings_.empty() || !(live_due_ || retry_due_)) {
+		return;
+	}
+
+	live_due_ = false;
+	retry_due_ = false;
+
+	/*
+	 * A packet that wasn't acknowledged is sent again with the same sequence
+	 * number and readings, so that the gateway can ignore it if it was only
+	 * the acknowledgement that was lost. Every other packet has a new
+	 * sequence number so that late acknowledgements are ignored.
+	 */
+	bool resend = gateway_resend_ && readings_.front().timestamp == gateway_ts_first_;
+
+	if (!resend) {
+		gateway_sequence_ = next_sequence();
+		gateway_ts_first_ = readings_.front().timestamp;
+	}
+
+	uint8_t data[peer::MAXIMUM_PACKET_BYTES];
+	uint8_t *pos = peer::write_header(data, peer::DATA, gateway_sequence_);
+	uint8_t *count;
+
+	*pos++ = sensor_name_.length();
+	pos = std::copy(sensor_name_.cbegin(), sensor_name_.cend(), pos);
+	count = pos++;
+	*count = 0;
+
+	/* Oldest first, so that they can be removed from the front when acknowledged */
+	for (const auto &reading : readings_) {
+		if (*count == peer::MAXIMUM_READINGS || (resend && reading.timestamp > gateway_ts_last_)) {
+			break;
+		}
+
+		reading.pack(pos);
+		pos += Reading::PACKED_BYTES;
+		gateway_ts_last_ = reading.timestamp;
+		(*count)++;
+	}
+
+	if (!gateway_udp_.beginPacket(gateway_host_.c_str(), gateway_port_)
+			|| gateway_udp_.write(data, pos - data) != static_cast<size_t>(pos - data)
+			|| !gateway_udp_.endPacket()) {
+		logger_.err(F("Upload failure, unable to send to gateway %s:%u"), gateway_host_.c_str(), gateway_port_);
+		Counters::increment(Counter::UPLOAD_FAILURES);
+		return;
+	}
+
+	Traffic::count(TrafficChannel::GATEWAY_UPLINK);
+	Traffic::sent(TrafficChannel::GATEWAY_UPLINK, *count * Reading::PACKED_BYTES,
+		(pos - data) - *count * Reading::PACKED_BYTES);
+
+	logger_.debug(F("Sent %u readings to gateway up to %u (sequence %u)"), *count, gateway_ts_last_, gateway_sequence_);
+	tracer_.mark(0, gateway_ts_last_, TraceStage::ENCODED);
+	tracer_.mark(0, gateway_ts_last_, TraceStage::SENT);
+	gateway_sent_ms_ = ::millis();
+	gateway_waiting_ = true;
+}
+
+void Report::loop() {
+	if (aggregate_s_ != 0 && !aggregator_.empty()
+			&& ::time(nullptr) >= static_cast<time_t>(aggregator_.start() + aggregate_s_)) {
+		flush_aggregate();
+	}
 
-void Report::loop() {
 	if (readings_.empty()) {
 		overflow_ = false;
-	} else {
+	}
+
+	while (!clock_adjustments_.empty() && (readings_.empty()
+			|| readings_.front().timestamp > clock_adjustments_.front().ts_last)) {
+		clock_adjustments_.erase(clock_adjustments_.begin());
+	}
+
+	if (peer_readings_.empty()) {
+		peer_overflow_ = false;
+	}
+
+	check_latency();
+
+	if (!readings_.empty() || !peer_readings_.empty() || state_ != UploadState::IDLE || gateway_waiting_) {
 		upload();
 	}
 }
@@ -1,6 +1,6 @@
 /*
  * scd30 - SCD30 Monitor
- * Copyright 2022  Simon Arlott
+ * Copyright 2022,2026  Simon Arlott
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -30,6 +30,9 @@
 #include "app/app.h"
 #include "app/console.h"
 #include "app/network.h"
+#include "gateway.h"
+#include "history_server.h"
+#include "modbus_server.h"
 #include "report.h"
 #include "sensor.h"
 
@@ -61,12 +64,20 @@ public:
 	void config_sensor(std::initializer_list<Operation> operations = {});
 	void calibrate_sensor(unsigned long ppm);
 	void config_report();
+	void config_modbus();
+	void config_gateway();
+	void config_history();
 
+	const Report& report() { return report_; }
 	const Sensor& sensor() { return sensor_; }
 
 private:
 	scd30::Report report_;
 	scd30::Sensor sensor_;
+	scd30::ModbusServer modbus_server_;
+	uint32_t modbus_reading_s_ = 0;
+	scd30::Gateway gateway_;
+	scd30::HistoryServer history_server_;
 };
 
 } // namespace scd30
@@ -0,0 +1,63 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <bitset>
+
+#include <uuid/log.h>
+
+namespace scd30 {
+
+enum class BootPhase : uint8_t {
+	START,
+	NETWORK,
+	TIME,
+	SENSOR_FIRMWARE,
+	SENSOR_CONFIG,
+	FIRST_READING,
+	CA_CERTS,
+	TLS_HANDSHAKE,
+	FIRST_UPLOAD,
+};
+
+/*
+ * Milestones from power on (millis() == 0) to the first successful upload.
+ * Only the first occurrence of each phase is recorded.
+ */
+class BootTiming {
+public:
+	static constexpr size_t PHASES = static_cast<size_t>(BootPhase::FIRST_UPLOAD) + 1;
+
+	static void mark(BootPhase phase);
+
+	static inline bool reached(BootPhase phase) { return reached_[static_cast<size_t>(phase)]; }
+	static inline uint32_t time_ms(BootPhase phase) { return time_ms_[static_cast<size_t>(phase)]; }
+	static const __FlashStringHelper *name(BootPhase phase);
+
+private:
+	static void log_summary();
+
+	static uuid::log::Logger logger_;
+	static std::bitset<PHASES> reached_;
+	static uint32_t time_ms_[PHASES];
+};
+
+} // namespace scd30
@@ -0,0 +1,119 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <uuid/log.h>
+
+namespace scd30 {
+
+enum class Counter : uint8_t {
+	MODBUS_ERRORS, /* Failed sensor transactions (each causes a sensor reset) */
+	UPLOAD_FAILURES,
+	OVERFLOW_DROPS, /* Readings discarded because the store is full */
+};
+
+enum class ResetCause : uint8_t {
+	POWER_ON,
+	EXTERNAL,
+	SOFTWARE,
+	EXCEPTION,
+	WATCHDOG,
+	DEEP_SLEEP,
+	BROWNOUT,
+	UNKNOWN,
+};
+
+/*
+ * Cumulative counters since boot and over the lifetime of the device.
+ *
+ * Lifetime values are copied to RTC memory when they change, which
+ * survives a reset but not a loss of power, and written to flash at most
+ * once an hour. At boot the newest valid copy is used.
+ *
+ * Sequence numbers (for upload batches and gateway packets) continue to
+ * increase across restarts. They are reserved in blocks that are written to
+ * flash before they're used, and the rest of the block is skipped at boot.
+ */
+class Counters {
+public:
+	static constexpr size_t COUNTERS = static_cast<size_t>(Counter::OVERFLOW_DROPS) + 1;
+	static constexpr size_t RESET_CAUSES = static_cast<size_t>(ResetCause::UNKNOWN) + 1;
+
+	static void start();
+	static void loop();
+	static void increment(Counter counter);
+	static void loop_time(uint32_t time_us);
+	static uint32_t next_sequence();
+
+	static const __FlashStringHelper *name(Counter counter);
+	static const __FlashStringHelper *name(ResetCause cause);
+
+	static inline ResetCause reset_cause() { return reset_cause_; }
+	static inline uint32_t boot(Counter counter) { return boot_[static_cast<size_t>(counter)]; }
+	static inline uint32_t lifetime(Counter counter) { return lifetime_.counters[static_cast<size_t>(counter)]; }
+	static inline uint32_t resets(ResetCause cause) { return lifetime_.resets[static_cast<size_t>(cause)]; }
+	static inline uint32_t boot_max_loop_us() { return boot_max_loop_us_; }
+	static inline uint32_t lifetime_max_loop_us() { return lifetime_.max_loop_us; }
+
+private:
+	static constexpr uint32_t MAGIC = 0x43444353; /* "SCDC" */
+	static constexpr uint32_t RTC_INTERVAL_MS = 1000;
+	static constexpr uint32_t FLASH_INTERVAL_MS = 60 * 60 * 1000;
+	static constexpr uint32_t SEQUENCE_BLOCK = 1024;
+
+	struct Record {
+		uint32_t magic;
+		uint32_t updates;
+		uint32_t resets[RESET_CAUSES];
+		uint32_t counters[COUNTERS];
+		uint32_t max_loop_us;
+		uint32_t sequence_reserved; /* Sequence numbers below this may have been used */
+		uint32_t crc;
+	};
+
+	static uint32_t crc32(const Record &record);
+	static bool valid(const Record &record);
+	static ResetCause read_reset_cause();
+	static bool read_rtc(Record &record);
+	static void write_rtc();
+	static bool read_flash(Record &record);
+	static void write_flash();
+	static void changed();
+
+	static uuid::log::Logger logger_;
+	static Record lifetime_;
+	static uint32_t boot_[COUNTERS];
+	static uint32_t boot_max_loop_us_;
+	static uint32_t sequence_;
+	static ResetCause reset_cause_;
+	static bool rtc_dirty_;
+	static bool flash_dirty_;
+	static uint32_t rtc_ms_;
+	static uint32_t flash_ms_;
+#ifdef ARDUINO_ARCH_ESP32
+	static Record rtc_;
+#endif
+};
+
+} // namespace scd30
@@ -0,0 +1,58 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+#include <array>
+
+#include <uuid/log.h>
+
+#include "peer.h"
+#include "report.h"
+
+namespace scd30 {
+
+/*
+ * Receives readings from peer devices (see peer.h) and adds them to the
+ * report, to be uploaded together with this device's own readings.
+ */
+class Gateway {
+public:
+	explicit Gateway(Report &report);
+
+	void config();
+	void loop();
+
+private:
+	static constexpr size_t MAXIMUM_PACKETS_PER_LOOP = 4;
+
+	static uuid::log::Logger logger_;
+
+	size_t receive(size_t length);
+	void acknowledge(uint32_t sequence);
+
+	Report &report_;
+	uint16_t port_ = 0;
+	WiFiUDP udp_;
+	std::array<uint8_t, peer::MAXIMUM_PACKET_BYTES> packet_;
+};
+
+} // namespace scd30
@@ -0,0 +1,100 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+
+#include <array>
+#include <memory>
+
+#include <uuid/log.h>
+
+#include "reading.h"
+#include "report.h"
+
+namespace scd30 {
+
+enum class HistoryState : uint8_t {
+	REQUEST,
+	HEADERS,
+	BODY,
+};
+
+/*
+ * HTTP server for the stored readings, so that they can be fetched directly
+ * instead of waiting for them to be uploaded:
+ *
+ *   GET /readings?from=<timestamp>&to=<timestamp>&format=<csv|binary>
+ *
+ * The time range is inclusive and both ends are optional. CSV has a header
+ * line with the field names; binary is a sequence of packed readings. The
+ * response is read from the store a buffer at a time, continuing from the
+ * timestamp after the last one sent, so memory use is fixed.
+ */
+class HistoryServer {
+public:
+	HistoryServer(const Report &report);
+
+	void config();
+	void loop();
+
+private:
+	static constexpr size_t MAXIMUM_CLIENTS = 2;
+	static constexpr size_t MAXIMUM_LINE_LENGTH = 128;
+	static constexpr size_t MAXIMUM_REQUEST_BYTES = 2048;
+	static constexpr size_t BUFFER_BYTES = 512;
+	static constexpr uint32_t CLIENT_TIMEOUT_MS = 10000;
+
+	static_assert(BUFFER_BYTES >= Reading::CSV_LENGTH + 1, "Buffer too small for a reading");
+
+	struct Connection {
+		WiFiClient client;
+		uint32_t activity_ms = 0;
+		HistoryState state = HistoryState::REQUEST;
+		size_t request_bytes = 0;
+		size_t line_length = 0;
+		std::array<char, MAXIMUM_LINE_LENGTH + 1> line;
+		int status = 200;
+		bool csv = true;
+		uint32_t next_ts = 0;
+		uint32_t last_ts = UINT32_MAX;
+		bool complete = false;
+		size_t buffer_length = 0;
+		size_t buffer_pos = 0;
+		std::array<uint8_t, BUFFER_BYTES> buffer;
+	};
+
+	static uuid::log::Logger logger_;
+
+	static bool parse_value(const char *text, uint32_t &value);
+	void parse_request(Connection &connection);
+	void receive(Connection &connection);
+	void respond(Connection &connection);
+	void fill(Connection &connection);
+	bool send(Connection &connection);
+
+	const Report &report_;
+	uint16_t port_ = 0;
+	std::unique_ptr<WiFiServer> server_;
+	std::array<Connection, MAXIMUM_CLIENTS> connections_;
+};
+
+} // namespace scd30
@@ -0,0 +1,107 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+
+#include <array>
+#include <memory>
+
+#include <uuid/log.h>
+
+#include "report.h"
+#include "sensor.h"
+
+namespace scd30 {
+
+/*
+ * Input register map (all values are big-endian 16-bit registers, 32-bit
+ * values are high word first):
+ *
+ *  0-1  Reading timestamp (Unix time)
+ *    2  Temperature (0.01°C, signed)
+ *    3  Relative humidity (0.01%)
+ *    4  CO₂ (ppm)
+ *    5  Dew point (0.01°C, signed)
+ *    6  Absolute humidity (0.01 g/m³)
+ *    7  Data age (ms)
+ *    8  Reading interval (s)
+ *
+ *   16  Aggregation window (s, 0 if disabled)
+ *   17  Readings in the current window
+ * 18-29 Temperature, relative humidity and CO₂ minimum, median, 95th
+ *       percentile and maximum in the current window (same units as above)
+ *
+ * 32-33 Uptime (s)
+ *   34  Stored readings
+ *   35  Reading storage capacity
+ * 36-37 Successful uploads
+ * 38-39 Failed uploads
+ *   40  Clock steps
+ *
+ * Values that are not available are 0x8000 (signed) or 0xFFFF (unsigned).
+ * Registers are updated when there's a new reading, except for the uptime
+ * which is current when it's read.
+ */
+class ModbusServer {
+public:
+	static constexpr size_t REGISTERS = 41;
+
+	ModbusServer();
+
+	void config();
+	void update(const Sensor &sensor, const Report &report);
+	void loop();
+
+private:
+	static constexpr size_t MAXIMUM_CLIENTS = 2;
+	static constexpr size_t MBAP_HEADER_BYTES = 7;
+	static constexpr size_t MAXIMUM_FRAME_BYTES = 260;
+	static constexpr uint32_t CLIENT_TIMEOUT_MS = 60000;
+
+	static constexpr uint8_t FUNCTION_READ_HOLDING_REGISTERS = 0x03;
+	static constexpr uint8_t FUNCTION_READ_INPUT_REGISTERS = 0x04;
+	static constexpr uint8_t EXCEPTION_ILLEGAL_FUNCTION = 0x01;
+	static constexpr uint8_t EXCEPTION_ILLEGAL_DATA_ADDRESS = 0x02;
+	static constexpr uint8_t EXCEPTION_ILLEGAL_DATA_VALUE = 0x03;
+	static constexpr uint16_t MAXIMUM_READ_REGISTERS = 125;
+
+	struct Connection {
+		WiFiClient client;
+		uint32_t activity_ms = 0;
+		size_t length = 0;
+		std::array<uint8_t, MAXIMUM_FRAME_BYTES> frame;
+	};
+
+	static uuid::log::Logger logger_;
+
+	void set32(size_t address, uint32_t value);
+	bool receive(Connection &connection);
+	void respond(Connection &connection);
+	void respond_exception(Connection &connection, uint8_t code);
+
+	uint16_t port_ = 0;
+	std::unique_ptr<WiFiServer> server_;
+	std::array<Connection, MAXIMUM_CLIENTS> connections_;
+	std::array<uint16_t, REGISTERS> registers_{};
+};
+
+} // namespace scd30
@@ -0,0 +1,114 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "reading.h"
+
+namespace scd30 {
+
+/*
+ * UDP protocol used by peer devices to send their readings to a gateway.
+ *
+ * Data packet:
+ *   magic (4) "SCDp"
+ *   type (1) DATA
+ *   sequence (4, little-endian)
+ *   sensor name length (1), sensor name
+ *   reading count (1), packed readings (Reading::PACKED_BYTES each)
+ *
+ * Acknowledgement (sent back to the source address and port):
+ *   magic (4) "SCDp"
+ *   type (1) ACK
+ *   sequence (4, little-endian)
+ */
+namespace peer {
+
+enum Type : uint8_t {
+	DATA = 1,
+	ACK = 2,
+};
+
+constexpr uint8_t MAGIC[] = { 'S', 'C', 'D', 'p' };
+constexpr uint16_t DEFAULT_PORT = 30330;
+constexpr size_t HEADER_BYTES = sizeof(MAGIC) + 1 + sizeof(uint32_t);
+constexpr size_t MAXIMUM_NAME_LENGTH = 32;
+constexpr size_t MAXIMUM_READINGS = 40;
+constexpr size_t MAXIMUM_PACKET_BYTES = HEADER_BYTES + 1 + MAXIMUM_NAME_LENGTH + 1
+	+ MAXIMUM_READINGS * Reading::PACKED_BYTES;
+
+/* Sensor names are printable ASCII without spaces */
+inline bool valid_name(const char *name, size_t length) {
+	if (length == 0 || length > MAXIMUM_NAME_LENGTH) {
+		return false;
+	}
+
+	for (size_t i = 0; i < length; i++) {
+		if (name[i] <= ' ' || name[i] > '~') {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Write the packet header to data, returns the end of the header */
+inline uint8_t *write_header(uint8_t *data, Type type, uint32_t sequence) {
+	for (size_t i = 0; i < sizeof(MAGIC); i++) {
+		*data++ = MAGIC[i];
+	}
+
+	*data++ = type;
+
+	for (size_t i = 0; i < sizeof(uint32_t); i++) {
+		*data++ = sequence >> (i * 8);
+	}
+
+	return data;
+}
+
+/* Check the packet header, returns the end of the header or nullptr */
+inline const uint8_t *read_header(const uint8_t *data, size_t length, Type type, uint32_t &sequence) {
+	if (length < HEADER_BYTES) {
+		return nullptr;
+	}
+
+	for (size_t i = 0; i < sizeof(MAGIC); i++) {
+		if (*data++ != MAGIC[i]) {
+			return nullptr;
+		}
+	}
+
+	if (*data++ != type) {
+		return nullptr;
+	}
+
+	sequence = 0;
+	for (size_t i = 0; i < sizeof(uint32_t); i++) {
+		sequence |= static_cast<uint32_t>(*data++) << (i * 8);
+	}
+
+	return data;
+}
+
+} // namespace peer
+
+} // namespace scd30
@@ -0,0 +1,77 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "reading.h"
+
+namespace scd30 {
+
+namespace psychrometrics {
+
+enum Field : size_t {
+	DEW_POINT,
+	ABSOLUTE_HUMIDITY,
+	FIELDS,
+};
+
+/* Derived from the stored temperature and relative humidity of a Reading */
+constexpr ReadingField DERIVED_FIELDS[] = {
+	{ "dew_point", 'd', 14, 100, true },
+	{ "absolute_humidity", 'a', 16, 100, false },
+};
+
+static_assert(sizeof(DERIVED_FIELDS) / sizeof(DERIVED_FIELDS[0]) == FIELDS, "Field descriptors do not match fields");
+
+/* "&d=-123.45&a=123.45" */
+constexpr size_t TEXT_LENGTH = reading_field_text_length(DERIVED_FIELDS[DEW_POINT])
+	+ reading_field_text_length(DERIVED_FIELDS[ABSOLUTE_HUMIDITY]);
+
+/*
+ * Magnus formula (b = 17.62, c = 243.12°C) evaluated in fixed point with
+ * lookup tables for log2() and exp2(), so that no floating point library
+ * functions are used.
+ *
+ * Inputs and outputs are in the units of their field descriptors (0.01°C,
+ * 0.01% and 0.01 g/m³). Returns the field's nan() value if the input is out
+ * of range.
+ */
+int32_t dew_point(int32_t temperature_c, int32_t relative_humidity_pc);
+int32_t absolute_humidity(int32_t temperature_c, int32_t relative_humidity_pc);
+
+/*
+ * The same formulas with expf() and logf(), for comparison. The targets have
+ * no FPU so these are in software there, but on a host with an FPU they are
+ * faster than the fixed point versions.
+ */
+float dew_point_float(float temperature_c, float relative_humidity_pc);
+float absolute_humidity_float(float temperature_c, float relative_humidity_pc);
+
+/*
+ * Append the form encoding of the derived values for a reading to text,
+ * which must have space for TEXT_LENGTH characters. Returns the end of the
+ * text (not terminated).
+ */
+char *format_text(const Reading &reading, char *text);
+
+} // namespace psychrometrics
+
+} // namespace scd30
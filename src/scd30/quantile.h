@@ -0,0 +1,54 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace scd30 {
+
+/*
+ * P² streaming quantile estimator (Jain and Chlamtac, 1985) using five
+ * markers, so the memory used is fixed regardless of the number of values.
+ * The estimate is exact until there are more than five values.
+ */
+class QuantileSketch {
+public:
+	explicit QuantileSketch(float quantile = 0.5f);
+
+	inline uint32_t count() const { return count_; }
+
+	void reset();
+	void add(int32_t value);
+	int32_t estimate() const;
+
+private:
+	static constexpr size_t MARKERS = 5;
+
+	float parabolic(size_t i, int d) const;
+	float linear(size_t i, int d) const;
+
+	float quantile_;
+	uint32_t count_ = 0;
+	float height_[MARKERS];
+	int32_t position_[MARKERS];
+	float desired_[MARKERS];
+};
+
+} // namespace scd30
@@ -0,0 +1,411 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2022,2024,2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * This header has no Arduino dependencies so that the record format can be
+ * shared with host tools.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace scd30 {
+
+/*
+ * Fixed point encoding of a quantity. Values are stored as an integer
+ * multiple of 1/div, clamped to [min, max] with nan() used for non-finite
+ * values.
+ */
+struct ReadingField {
+	const char *name;
+	char key;
+	size_t bits;
+	int div;
+	bool is_signed;
+
+	constexpr int mul() const { return 100 / div; }
+	constexpr int32_t min() const { return is_signed ? -(INT32_C(1) << (bits - 1)) + 1 : 0; }
+	constexpr int32_t max() const { return is_signed ? (INT32_C(1) << (bits - 1)) - 1 : (INT32_C(1) << bits) - 2; }
+	constexpr int32_t nan() const { return is_signed ? min() - 1 : max() + 1; }
+	constexpr uint32_t mask() const { return (UINT32_C(1) << bits) - 1; }
+};
+
+/* Stored fields, in packed bit order after the timestamp */
+constexpr ReadingField READING_FIELDS[] = {
+	{ "temperature", 't', 14, 100, true },
+	{ "relative_humidity", 'h', 14, 100, false },
+	{ "co2", 'c', 20, 20, false },
+};
+
+constexpr size_t reading_field_offset(size_t index) {
+	return index == 0 ? 0 : reading_field_offset(index - 1) + READING_FIELDS[index - 1].bits;
+}
+
+constexpr size_t reading_decimal_digits(uint32_t value) {
+	return value < 10 ? 1 : 1 + reading_decimal_digits(value / 10);
+}
+
+constexpr size_t reading_field_text_length(const ReadingField &field, size_t suffix_length = 0) {
+	/* "&k=-123.45" */
+	return 3 + suffix_length + (field.is_signed ? 1 : 0) + reading_decimal_digits(field.max() / field.div) + 3;
+}
+
+constexpr size_t reading_fields_text_length(size_t count, size_t suffix_length = 0) {
+	return count == 0 ? 0 : reading_fields_text_length(count - 1, suffix_length)
+		+ reading_field_text_length(READING_FIELDS[count - 1], suffix_length);
+}
+
+struct __attribute__((packed)) Reading {
+	enum Field : size_t {
+		TEMPERATURE,
+		RELATIVE_HUMIDITY,
+		CO2,
+		FIELDS,
+	};
+
+	static_assert(sizeof(READING_FIELDS) / sizeof(READING_FIELDS[0]) == FIELDS, "Field descriptors do not match fields");
+
+	static_assert(READING_FIELDS[TEMPERATURE].div * READING_FIELDS[TEMPERATURE].mul() == 100, "Temperature division and multiplier are not factors of 100");
+	static_assert(READING_FIELDS[TEMPERATURE].min() == -8191, "Unexpected value for minimum temperature"); /* -81.91°C */
+	static_assert(READING_FIELDS[TEMPERATURE].max() == 8191, "Unexpected value for maximum temperature"); /* 81.91°C */
+
+	static_assert(READING_FIELDS[RELATIVE_HUMIDITY].div * READING_FIELDS[RELATIVE_HUMIDITY].mul() == 100, "Relative humidity division and multiplier are not factors of 100");
+	static_assert(READING_FIELDS[RELATIVE_HUMIDITY].min() == 0, "Unexpected value for minimum relative humidity"); /* 0% */
+	static_assert(READING_FIELDS[RELATIVE_HUMIDITY].max() == 16382, "Unexpected value for maximum relative humidity"); /* 163.82% */
+
+	static_assert(READING_FIELDS[CO2].div * READING_FIELDS[CO2].mul() == 100, "CO₂ division and multiplier are not factors of 100");
+	static_assert(READING_FIELDS[CO2].min() == 0, "Unexpected value for minimum CO₂"); /* 0 ppm */
+	static_assert(READING_FIELDS[CO2].max() == 1048574, "Unexpected value for maximum CO₂"); /* 41942.96 ppm */
+
+	/* Timestamp followed by the fields, little-endian */
+	static constexpr size_t PACKED_BYTES = sizeof(uint32_t) + (reading_field_offset(FIELDS) + 7) / 8;
+	static_assert(PACKED_BYTES == 10, "Unexpected size of packed reading");
+
+	/* "&s=1234567890" followed by the fields */
+	static constexpr size_t TEXT_LENGTH = 3 + reading_decimal_digits(UINT32_MAX) + reading_fields_text_length(FIELDS);
+
+	/* "1234567890,-123.45,..." (each field without its "&k=" key, but with a comma) */
+	static constexpr size_t CSV_LENGTH = reading_decimal_digits(UINT32_MAX) + reading_fields_text_length(FIELDS) - FIELDS * 2;
+
+	Reading(uint32_t timestamp_, float temperature_c_,
+			float relative_humidity_pc_, float co2_ppm_)
+			: timestamp(timestamp_) {
+		set<TEMPERATURE>(encode<TEMPERATURE>(temperature_c_));
+		set<RELATIVE_HUMIDITY>(encode<RELATIVE_HUMIDITY>(relative_humidity_pc_));
+		set<CO2>(encode<CO2>(co2_ppm_));
+	}
+
+	/* All fields set to NaN */
+	explicit Reading(uint32_t timestamp_) : timestamp(timestamp_) {
+		for (size_t i = 0; i < FIELDS; i++) {
+			set_field(i, READING_FIELDS[i].nan());
+		}
+	}
+
+	template <size_t I>
+	static inline int32_t encode(float value) {
+		static_assert(I < FIELDS, "Invalid field");
+
+		if (std::isfinite(value)) {
+			return std::max(READING_FIELDS[I].min(), std::min(READING_FIELDS[I].max(),
+				static_cast<int32_t>(std::lroundf(value * READING_FIELDS[I].div))));
+		} else {
+			return READING_FIELDS[I].nan();
+		}
+	}
+
+	template <size_t I>
+	inline int32_t get() const {
+		return get(std::integral_constant<size_t, I>{});
+	}
+
+	template <size_t I>
+	inline void set(int32_t value) {
+		set(std::integral_constant<size_t, I>{}, value);
+	}
+
+	inline int32_t get_field(size_t index) const {
+		switch (index) {
+		case TEMPERATURE: return get<TEMPERATURE>();
+		case RELATIVE_HUMIDITY: return get<RELATIVE_HUMIDITY>();
+		case CO2: return get<CO2>();
+		default: return 0;
+		}
+	}
+
+	inline void set_field(size_t index, int32_t value) {
+		switch (index) {
+		case TEMPERATURE: set<TEMPERATURE>(value); break;
+		case RELATIVE_HUMIDITY: set<RELATIVE_HUMIDITY>(value); break;
+		case CO2: set<CO2>(value); break;
+		default: break;
+		}
+	}
+
+	template <size_t I>
+	inline bool is_nan() const {
+		return get<I>() == READING_FIELDS[I].nan();
+	}
+
+	/*
+	 * Append the form encoding of this reading to text, which must have space
+	 * for TEXT_LENGTH characters. Returns the end of the text (not terminated).
+	 */
+	inline char *format_text(char *text) const {
+		text = format_key(text, 's');
+		text = format_decimal(text, timestamp);
+		return format_fields<0>(text);
+	}
+
+	/*
+	 * Append the CSV encoding of this reading to text, which must have space
+	 * for CSV_LENGTH characters. Fields that are NaN are empty. Returns the
+	 * end of the text (not terminated).
+	 */
+	inline char *format_csv(char *text) const {
+		text = format_decimal(text, timestamp);
+
+		for (size_t i = 0; i < FIELDS; i++) {
+			*text++ = ',';
+			text = format_number(text, READING_FIELDS[i], get_field(i));
+		}
+
+		return text;
+	}
+
+	/* Write the PACKED_BYTES binary encoding of this reading to data */
+	inline void pack(uint8_t *data) const {
+		for (size_t i = 0; i < sizeof(uint32_t); i++) {
+			data[i] = timestamp >> (i * 8);
+		}
+
+		uint64_t bits = pack_fields<0>();
+
+		for (size_t i = sizeof(uint32_t); i < PACKED_BYTES; i++) {
+			data[i] = bits;
+			bits >>= 8;
+		}
+	}
+
+	/* Read a reading from its PACKED_BYTES binary encoding */
+	static inline Reading unpack(const uint8_t *data) {
+		uint32_t timestamp = 0;
+
+		for (size_t i = 0; i < sizeof(uint32_t); i++) {
+			timestamp |= static_cast<uint32_t>(data[i]) << (i * 8);
+		}
+
+		Reading reading{timestamp};
+		uint64_t bits = 0;
+
+		for (size_t i = PACKED_BYTES; i > sizeof(uint32_t); i--) {
+			bits = (bits << 8) | data[i - 1];
+		}
+
+		reading.unpack_fields<0>(bits);
+		return reading;
+	}
+
+	/*
+	 * Append the form encoding of a single value to text, which must have
+	 * space for reading_field_text_length(field, strlen(suffix)) characters.
+	 * Returns the end of the text (not terminated).
+	 */
+	static inline char *format_value(char *text, const ReadingField &field, int32_t value,
+			const char *suffix = nullptr) {
+		return format_number(format_key(text, field.key, suffix), field, value);
+	}
+
+	/* Append a value without a key (nothing if it is NaN) */
+	static inline char *format_number(char *text, const ReadingField &field, int32_t value) {
+		if (value != field.nan()) {
+			uint32_t abs_value;
+
+			if (field.is_signed && value < 0) {
+				*text++ = '-';
+				abs_value = -value;
+			} else {
+				abs_value = value;
+			}
+
+			text = format_decimal(text, abs_value / field.div);
+
+			uint32_t fraction = (abs_value % field.div) * field.mul();
+
+			*text++ = '.';
+			*text++ = '0' + fraction / 10;
+			*text++ = '0' + fraction % 10;
+		}
+
+		return text;
+	}
+
+	static inline char *format_key(char *text, char key, const char *suffix = nullptr) {
+		*text++ = '&';
+		*text++ = key;
+		if (suffix) {
+			while (*suffix) {
+				*text++ = *suffix++;
+			}
+		}
+		*text++ = '=';
+		return text;
+	}
+
+	static inline char *format_decimal(char *text, uint32_t value) {
+		char digits[10];
+		size_t len = 0;
+
+		do {
+			digits[len++] = '0' + (value % 10);
+			value /= 10;
+		} while (value);
+
+		while (len > 0) {
+			*text++ = digits[--len];
+		}
+
+		return text;
+	}
+
+	uint32_t timestamp;
+	signed int temperature_c : READING_FIELDS[TEMPERATURE].bits;
+	unsigned int relative_humidity_pc : READING_FIELDS[RELATIVE_HUMIDITY].bits;
+	unsigned int co2_ppm : READING_FIELDS[CO2].bits;
+
+private:
+	inline int32_t get(std::integral_constant<size_t, TEMPERATURE>) const { return temperature_c; }
+	inline int32_t get(std::integral_constant<size_t, RELATIVE_HUMIDITY>) const { return relative_humidity_pc; }
+	inline int32_t get(std::integral_constant<size_t, CO2>) const { return co2_ppm; }
+
+	inline void set(std::integral_constant<size_t, TEMPERATURE>, int32_t value) { temperature_c = value; }
+	inline void set(std::integral_constant<size_t, RELATIVE_HUMIDITY>, int32_t value) { relative_humidity_pc = value; }
+	inline void set(std::integral_constant<size_t, CO2>, int32_t value) { co2_ppm = value; }
+
+	template <size_t I>
+	inline char *format_field(char *text) const {
+		return format_value(text, READING_FIELDS[I], get<I>());
+	}
+
+	template <size_t I>
+	inline typename std::enable_if<(I < FIELDS), char*>::type format_fields(char *text) const {
+		return format_fields<I + 1>(format_field<I>(text));
+	}
+
+	template <size_t I>
+	inline typename std::enable_if<(I == FIELDS), char*>::type format_fields(char *text) const {
+		return text;
+	}
+
+	template <size_t I>
+	inline typename std::enable_if<(I < FIELDS), uint64_t>::type pack_fields() const {
+		return (static_cast<uint64_t>(static_cast<uint32_t>(get<I>()) & READING_FIELDS[I].mask()) << reading_field_offset(I))
+			| pack_fields<I + 1>();
+	}
+
+	template <size_t I>
+	inline typename std::enable_if<(I == FIELDS), uint64_t>::type pack_fields() const {
+		return 0;
+	}
+
+	template <size_t I>
+	inline typename std::enable_if<(I < FIELDS)>::type unpack_fields(uint64_t bits) {
+		uint32_t value = (bits >> reading_field_offset(I)) & READING_FIELDS[I].mask();
+
+		if (READING_FIELDS[I].is_signed && (value >> (READING_FIELDS[I].bits - 1))) {
+			value |= ~READING_FIELDS[I].mask();
+		}
+
+		set<I>(static_cast<int32_t>(value));
+		unpack_fields<I + 1>(bits);
+	}
+
+	template <size_t I>
+	inline typename std::enable_if<(I == FIELDS)>::type unpack_fields(uint64_t bits __attribute__((unused))) {
+	}
+};
+static_assert(sizeof(Reading) == 10, "Unexpected size of reading struct");
+
+/*
+ * Minimum, maximum, estimated median and 95th percentile, and count of the
+ * readings in an aggregation window. The mean is stored as a Reading with the
+ * same timestamp (the start of the window).
+ */
+struct __attribute__((packed)) ReadingSummary {
+	/*
+	 * "&w=12345&m=12345" (window length and number of measurements) followed
+	 * by the minimum and maximum of each field, then optionally the median
+	 * and 95th percentile of each field. The "n" key is the sensor name.
+	 */
+	static constexpr size_t TEXT_LENGTH = 3 + reading_decimal_digits(UINT16_MAX)
+		+ 3 + reading_decimal_digits(UINT16_MAX) + reading_fields_text_length(Reading::FIELDS, 4) * 4;
+
+	ReadingSummary(const Reading &minimum_, const Reading &maximum_,
+			const Reading &p50_, const Reading &p95_, uint16_t count_, uint16_t window_s_)
+			: minimum(minimum_), maximum(maximum_), p50(p50_), p95(p95_), count(count_), window_s(window_s_) {
+	}
+
+	inline uint32_t timestamp() const { return minimum.timestamp; }
+
+	inline void rebase(int32_t offset) {
+		minimum.timestamp += offset;
+		maximum.timestamp += offset;
+		p50.timestamp += offset;
+		p95.timestamp += offset;
+	}
+
+	/*
+	 * Append the form encoding of this summary to text, which must have space
+	 * for TEXT_LENGTH characters. Returns the end of the text (not terminated).
+	 */
+	inline char *format_text(char *text, bool quantiles) const {
+		text = Reading::format_key(text, 'w');
+		text = Reading::format_decimal(text, window_s);
+		text = Reading::format_key(text, 'm');
+		text = Reading::format_decimal(text, count);
+
+		for (size_t i = 0; i < Reading::FIELDS; i++) {
+			text = Reading::format_value(text, READING_FIELDS[i], minimum.get_field(i), "_min");
+			text = Reading::format_value(text, READING_FIELDS[i], maximum.get_field(i), "_max");
+		}
+
+		if (quantiles) {
+			for (size_t i = 0; i < Reading::FIELDS; i++) {
+				text = Reading::format_value(text, READING_FIELDS[i], p50.get_field(i), "_p50");
+				text = Reading::format_value(text, READING_FIELDS[i], p95.get_field(i), "_p95");
+			}
+		}
+
+		return text;
+	}
+
+	Reading minimum;
+	Reading maximum;
+	Reading p50;
+	Reading p95;
+	uint16_t count;
+	uint16_t window_s;
+};
+static_assert(sizeof(ReadingSummary) == 44, "Unexpected size of reading summary struct");
+
+} // namespace scd30
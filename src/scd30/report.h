@@ -1,6 +1,6 @@
 /*
  * scd30 - SCD30 Monitor
- * Copyright 2022,2024  Simon Arlott
+ * Copyright 2022,2024,2026  Simon Arlott
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -20,81 +20,26 @@
 
 #include <Arduino.h>
 #ifdef ARDUINO_ARCH_ESP8266
-# include <ESP8266HTTPClient.h>
 # include <WiFiClientSecureBearSSL.h>
-#else
-# pragma GCC diagnostic push
-# pragma GCC diagnostic ignored "-Wswitch-enum"
-# include <HTTPClient.h>
-# pragma GCC diagnostic pop
 #endif
 #include <WiFiClient.h>
+#include <WiFiUdp.h>
 
-#include <cmath>
 #include <deque>
+#include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <uuid/log.h>
 
-namespace scd30 {
+#include "psychrometrics.h"
+#include "quantile.h"
+#include "reading.h"
+#include "ring_buffer.h"
+#include "trace.h"
 
-struct __attribute__((packed)) Reading {
-	static constexpr size_t TEMP_BITS = 14;
-	static constexpr int TEMP_DIV = 100;
-	static constexpr int TEMP_MUL = 100 / TEMP_DIV;
-	static_assert(TEMP_DIV * TEMP_MUL == 100, "Temperature division and multiplier are not factors of 100");
-	static constexpr long TEMP_MIN = -(1 << (TEMP_BITS - 1)) + 1;
-	static_assert(TEMP_MIN == -8191, "Unexpected value for minimum temperature"); /* -81.91°C */
-	static constexpr long TEMP_MAX = (1 << (TEMP_BITS - 1)) - 1;
-	static_assert(TEMP_MAX == 8191, "Unexpected value for maximum temperature"); /* 81.91°C */
-	static constexpr long TEMP_NAN = TEMP_MIN - 1;
-
-	static constexpr size_t RHUM_BITS = 14;
-	static constexpr int RHUM_DIV = 100;
-	static constexpr int RHUM_MUL = 100 / RHUM_DIV;
-	static_assert(RHUM_DIV * RHUM_MUL == 100, "Relative humidity division and multiplier are not factors of 100");
-	static constexpr long RHUM_MIN = 0; /* 0% */
-	static constexpr long RHUM_MAX = (1 << RHUM_BITS) - 2;
-	static_assert(RHUM_MAX == 16382, "Unexpected value for maximum relative humidity"); /* 163.82% */
-	static constexpr long RHUM_NAN = RHUM_MAX + 1;
-
-	static constexpr size_t CO2_BITS = 20;
-	static constexpr int CO2_DIV = 20;
-	static constexpr int CO2_MUL = 100 / CO2_DIV;
-	static_assert(CO2_DIV * CO2_MUL == 100, "CO₂ division and multiplier are not factors of 100");
-	static constexpr long CO2_MIN = 0; /* 0 ppm */
-	static constexpr long CO2_MAX = (1 << CO2_BITS) - 2;
-	static_assert(CO2_MAX == 1048574, "Unexpected value for maximum CO₂"); /* 41942.96 ppm */
-	static constexpr long CO2_NAN = CO2_MAX + 1;
-
-	Reading(uint32_t timestamp_, float temperature_c_,
-			float relative_humidity_pc_, float co2_ppm_)
-			: timestamp(timestamp_) {
-		if (std::isfinite(temperature_c_)) {
-			temperature_c = std::max(TEMP_MIN, std::min(TEMP_MAX, std::lroundf(temperature_c_ * TEMP_DIV)));
-		} else {
-			temperature_c = TEMP_NAN;
-		}
-
-		if (std::isfinite(relative_humidity_pc_)) {
-			relative_humidity_pc = std::max(RHUM_MIN, std::min(RHUM_MAX, std::lroundf(relative_humidity_pc_ * RHUM_DIV)));
-		} else {
-			relative_humidity_pc = RHUM_NAN;
-		}
-
-		if (std::isfinite(co2_ppm_)) {
-			co2_ppm = std::max(CO2_MIN, std::min(CO2_MAX, std::lroundf(co2_ppm_ * CO2_DIV)));
-		} else {
-			co2_ppm = CO2_NAN;
-		}
-	}
-
-	uint32_t timestamp;
-	signed int temperature_c : TEMP_BITS;
-	unsigned int relative_humidity_pc : RHUM_BITS;
-	unsigned int co2_ppm : CO2_BITS;
-};
-static_assert(sizeof(Reading) == 10, "Unexpected size of reading struct");
+namespace scd30 {
 
 enum class UploadState : uint8_t {
 	IDLE,
@@ -104,26 +49,235 @@ enum class UploadState : uint8_t {
 	CLEANUP,
 };
 
+enum class ResponseState : uint8_t {
+	STATUS,
+	HEADERS,
+	BODY,
+	CHUNK_SIZE, /* Transfer-Encoding: chunked */
+	CHUNK_DATA,
+	CHUNK_END,
+	TRAILERS,
+};
+
+enum class ResponseResult : uint8_t {
+	PENDING,
+	OK,
+	FAILED,
+};
+
+enum class UploadLane : uint8_t {
+	LIVE, /* Newest readings, as soon as the threshold is reached */
+	BACKFILL, /* Older readings, when there are no live readings to upload */
+	PEER, /* Readings received from peer devices (timestamps are peer reading IDs) */
+};
+
+/* Clock step that has been applied to stored readings */
+struct ClockAdjustment {
+	uint32_t ts_last; /* Last reading that was adjusted (after adjustment) */
+	int32_t offset;
+};
+
+/* Encoded request body, kept until it has been acknowledged */
+struct UploadBatch {
+	uint32_t sequence;
+	uint32_t ts_first;
+	uint32_t ts_last;
+	size_t count;
+	UploadLane lane;
+	bool sent;
+	uint32_t sent_ms;
+	String payload;
+};
+
+/* Upload destination, with health tracking for failover */
+struct UploadEndpoint {
+	std::string url;
+	bool tls = false;
+	std::string host;
+	uint16_t port = 0;
+	std::string path;
+
+	uint32_t rtt_ms = 0; /* Smoothed round trip time */
+	uint8_t failure_rate = 0; /* Smoothed, out of 255 */
+	uint8_t failures = 0; /* Consecutive */
+	uint32_t failed_ms = 0;
+	unsigned long uploads = 0;
+	unsigned long errors = 0;
+};
+
+/* Peer device sending readings to this gateway */
+struct PeerDevice {
+	std::string name;
+	uint32_t timestamp; /* Most recent reading */
+	unsigned long readings;
+	uint32_t sequence; /* Most recent packet */
+};
+
+/* Reading received from a peer device */
+struct __attribute__((packed)) PeerReading {
+	uint32_t id;
+	uint8_t peer;
+	Reading reading;
+};
+
+/* Accumulates readings over an aggregation window */
+class ReadingAggregator {
+public:
+	static constexpr float MEDIAN = 0.5f;
+	static constexpr float UPPER_PERCENTILE = 0.95f;
+
+	ReadingAggregator();
+
+	inline bool empty() const { return count_ == 0; }
+	inline uint32_t start() const { return start_; }
+	inline uint16_t count() const { return count_; }
+
+	void reset(uint32_t start);
+	void add(const Reading &reading);
+	Reading mean() const;
+	ReadingSummary summary(uint16_t window_s) const;
+
+private:
+	uint32_t start_ = 0;
+	uint16_t count_ = 0;
+	uint16_t field_count_[Reading::FIELDS];
+	int64_t sum_[Reading::FIELDS];
+	int32_t minimum_[Reading::FIELDS];
+	int32_t maximum_[Reading::FIELDS];
+	QuantileSketch p50_[Reading::FIELDS];
+	QuantileSketch p95_[Reading::FIELDS];
+};
+
 class Report {
 public:
+	static constexpr uint32_t MINIMUM_TIMESTAMP = 19035 * 86400;
+	static constexpr size_t MAXIMUM_PIPELINE = 8;
+	static constexpr size_t MAXIMUM_ENDPOINTS = 3;
+	static constexpr size_t MINIMUM_STORE_READINGS = 60;
+	static constexpr size_t MAXIMUM_STORE_READINGS = 65535;
+	static constexpr unsigned long MAXIMUM_STORE_MEMORY_PC = 75;
+	static constexpr size_t MAXIMUM_PEERS = 64;
+
+	using reading_iterator = RingBuffer<Reading>::const_iterator;
+
 	void config();
-	void add(uint32_t timestamp, float temperature_c, float relative_humidity_pc, float co2_ppm);
+	void add(uint32_t timestamp, float temperature_c, float relative_humidity_pc, float co2_ppm,
+		uint32_t ready_ms, uint32_t read_ms);
+	bool add_peer(const std::string &name, uint32_t sequence, const uint8_t *data, size_t count);
 	void loop();
 
+	inline UploadState state() const { return state_; }
+	inline size_t capacity() const { return capacity_; }
+	inline size_t size() const { return readings_.size(); }
+	std::pair<reading_iterator, reading_iterator> find(uint32_t first, uint32_t last) const;
+	inline unsigned long clock_steps() const { return clock_steps_; }
+	inline unsigned long clock_repairs() const { return clock_repairs_; }
+	inline uint16_t aggregate_s() const { return aggregate_s_; }
+	inline const std::vector<UploadEndpoint>& endpoints() const { return endpoints_; }
+	inline size_t endpoint() const { return endpoint_; }
+	bool endpoint_down(const UploadEndpoint &endpoint) const;
+	uint32_t endpoint_retry_ms(const UploadEndpoint &endpoint) const;
+	uint32_t retry_ms() const;
+	unsigned long uploads() const;
+	unsigned long upload_errors() const;
+	inline const ReadingAggregator& aggregator() const { return aggregator_; }
+	inline const LatencyTracer& latency() const { return tracer_; }
+	inline const std::string& gateway() const { return gateway_host_; }
+	inline const std::vector<PeerDevice>& peers() const { return peers_; }
+	inline size_t peer_size() const { return peer_readings_.size(); }
+	inline size_t peer_capacity() const { return peer_readings_.capacity(); }
+
+	/* Defaults to the persistent device-wide sequence (Counters) */
+	inline void sequence_source(std::function<uint32_t ()> func) { sequence_source_ = std::move(func); }
+
 private:
-	static constexpr size_t MAXIMUM_STORE_READINGS = 360; /* 30 minutes at a 5 second interval */
 	static constexpr size_t MAXIMUM_UPLOAD_BYTES = 640;
+	static constexpr size_t MAXIMUM_HEADER_BYTES = 256;
+	static constexpr size_t RECORD_TEXT_LENGTH = Reading::TEXT_LENGTH
+		+ psychrometrics::TEXT_LENGTH + ReadingSummary::TEXT_LENGTH
+		+ 3 + 1 + reading_decimal_digits(UINT32_MAX);
+	static constexpr size_t MAXIMUM_RESPONSE_BYTES = 1024;
+	static constexpr size_t RESPONSE_LINE_LENGTH = 40;
+	static constexpr long RESPONSE_BODY_LENGTH = 3; /* "OK\n" */
 	static constexpr int HTTP_TIMEOUT_MS = 2000;
+	static constexpr int32_t CLOCK_STEP_TOLERANCE_S = 5;
+	static constexpr size_t MAXIMUM_CLOCK_ADJUSTMENTS = 8;
+	static constexpr uint32_t ENDPOINT_RETRY_MS = 60000;
+	static constexpr uint32_t ENDPOINT_PREFERENCE_MS = 100; /* Per position in the list */
+	static constexpr uint32_t ENDPOINT_UNMEASURED_RTT_MS = 60000; /* Worse than any measured RTT */
+	static constexpr uint32_t GATEWAY_TIMEOUT_MS = 1000;
+	static constexpr size_t TLS_RESERVE_BYTES = 20480; /* BearSSL context, buffers and stack */
+	static constexpr uint32_t RETRY_MINIMUM_MS = 5000;
+	static constexpr uint32_t RETRY_MAXIMUM_MS = 300000;
+
+	using peer_iterator = RingBuffer<PeerReading>::const_iterator;
 
 	static uuid::log::Logger logger_;
 
-	void upload(bool begin = false);
+	void check_clock(uint32_t timestamp);
+	void rebase(int32_t offset);
+	int32_t adjustment(uint32_t timestamp) const;
+	void flush_aggregate();
+	void resize();
+	void discard_oldest();
+	void discard_peer_oldest();
+	void store(const Reading &reading, const ReadingSummary *summary = nullptr);
+	static bool parse_url(UploadEndpoint &endpoint);
+	void use_endpoint(size_t index);
+	bool select_endpoint(bool any);
+	void endpoint_success(const UploadBatch &batch);
+	bool endpoint_failure();
+	void disconnect();
+	size_t live_pending() const;
+	void check_latency();
+	peer_iterator peer_begin(uint32_t id) const;
+	size_t peer_pending() const;
+	void backfill_range(reading_iterator &begin, reading_iterator &end) const;
+	bool next_lane(UploadLane &lane) const;
+	uint32_t next_sequence();
+	static size_t url_encoded_length(const std::string &value);
+	static char *url_encode(char *text, const std::string &value);
+	static void url_encode(String &payload, const std::string &value);
+	char *format_record(char *text, const Reading &reading, const ReadingSummary *summary,
+		int32_t adjustment = 0) const;
+	void encode_live(const Reading &reading, const ReadingSummary *summary);
+	bool encode_batch(UploadLane lane, UploadBatch &batch);
+	void encode_peers(UploadBatch &batch, String &payload);
+	bool send_request(UploadBatch &batch);
+	void discard_batches(uint32_t timestamp);
+	void discard_peer_batches(uint32_t id);
+	void receive_start();
+	ResponseResult receive_line();
+	ResponseResult receive_body();
+	ResponseResult receive_response();
+	void upload_failed();
+	void upload();
+	void upload_gateway();
 
-	std::deque<Reading> readings_;
+	RingBuffer<Reading> readings_;
+	RingBuffer<ReadingSummary> summaries_;
+	size_t capacity_ = 0;
+	unsigned long capacity_config_ = 0;
+	unsigned long memory_pc_ = 0;
+	uint32_t clock_ts_ = 0;
+	uint32_t clock_ms_ = 0;
+	unsigned long clock_steps_ = 0;
+	unsigned long clock_repairs_ = 0;
+	std::vector<ClockAdjustment> clock_adjustments_;
 	bool enabled_ = false;
 	bool overflow_ = false;
 	size_t threshold_ = 0;
-	std::string url_;
+	uint32_t max_latency_s_ = 0;
+	bool derived_ = false;
+	bool quantiles_ = false;
+	bool latency_ = false;
+	size_t backfill_batch_ = 0;
+	uint16_t aggregate_s_ = 0;
+	ReadingAggregator aggregator_;
+	LatencyTracer tracer_;
+	size_t pipeline_ = 1;
+	std::vector<UploadEndpoint> endpoints_;
+	size_t endpoint_ = 0;
 	std::string username_;
 	std::string password_;
 	std::string sensor_name_;
@@ -137,10 +291,51 @@ private:
 #else
 	WiFiClient *conn_client_ = &tcp_client_;
 #endif
-	HTTPClient http_client_;
 	UploadState state_ = UploadState::IDLE;
-	uint32_t upload_ts_first_;
-	uint32_t upload_ts_last_;
+	std::deque<UploadBatch> batches_;
+	uint32_t receive_start_ms_ = 0;
+	ResponseState response_state_ = ResponseState::STATUS;
+	size_t response_bytes_ = 0;
+	size_t response_pos_ = 0;
+	int response_code_ = -1;
+	long response_length_ = -1;
+	bool response_chunked_ = false;
+	unsigned long response_chunk_ = 0;
+	char response_line_[RESPONSE_LINE_LENGTH + 1];
+	size_t response_body_pos_ = 0;
+	char response_body_[RESPONSE_BODY_LENGTH + 1];
+	bool close_ = false;
+	bool live_due_ = false;
+	bool retry_due_ = false;
+	bool backfill_ready_ = false;
+	uint32_t retry_start_ms_ = 0;
+	uint32_t retry_wait_ms_ = 0; /* Backoff after a failure with no other endpoint */
+	uint32_t live_ts_last_ = 0;
+	String live_text_;
+	size_t live_text_limit_ = 0;
+	size_t live_text_count_ = 0;
+	uint32_t live_text_first_ = 0;
+	uint32_t live_text_last_ = 0;
+	bool live_text_valid_ = false;
+
+	std::vector<PeerDevice> peers_;
+	RingBuffer<PeerReading> peer_readings_;
+	size_t peer_capacity_ = 0;
+	uint32_t peer_id_ = 0;
+	uint32_t peer_id_sent_ = 0;
+	bool peer_overflow_ = false;
+	bool gateway_server_ = false;
+
+	std::string gateway_host_;
+	uint16_t gateway_port_ = 0;
+	WiFiUDP gateway_udp_;
+	bool gateway_waiting_ = false;
+	uint32_t gateway_sequence_ = 0;
+	std::function<uint32_t ()> sequence_source_;
+	uint32_t gateway_sent_ms_ = 0;
+	uint32_t gateway_ts_first_ = 0;
+	uint32_t gateway_ts_last_ = 0;
+	bool gateway_resend_ = false;
 };
 
 } // namespace scd30
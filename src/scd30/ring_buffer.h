@@ -0,0 +1,203 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+namespace scd30 {
+
+/*
+ * Fixed capacity queue of trivially copyable records, allocated once so that
+ * storing records during an outage doesn't need any more memory (which may
+ * no longer be available because the heap is fragmented).
+ *
+ * Records are added to the back and removed from the front. Removing a range
+ * from the back (or the middle) moves the following records.
+ */
+template <class T>
+class RingBuffer {
+	static_assert(std::is_trivially_copyable<T>::value, "Records must be trivially copyable");
+	static_assert(std::is_trivially_destructible<T>::value, "Records must be trivially destructible");
+
+	template <class Value>
+	class basic_iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = typename std::remove_const<Value>::type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = Value*;
+		using reference = Value&;
+		using ring_type = typename std::conditional<std::is_const<Value>::value, const RingBuffer, RingBuffer>::type;
+
+		basic_iterator() = default;
+		basic_iterator(ring_type *ring, size_t index) : ring_(ring), index_(index) {}
+
+		/* Iterators convert to const iterators */
+		template <class Other, class = typename std::enable_if<std::is_same<const Other, Value>::value>::type>
+		basic_iterator(const basic_iterator<Other> &other) : ring_(other.ring_), index_(other.index_) {}
+
+		inline reference operator*() const { return (*ring_)[index_]; }
+		inline pointer operator->() const { return &(*ring_)[index_]; }
+		inline reference operator[](difference_type n) const { return (*ring_)[index_ + n]; }
+
+		inline basic_iterator &operator++() { index_++; return *this; }
+		inline basic_iterator &operator--() { index_--; return *this; }
+		inline basic_iterator operator++(int) { basic_iterator it = *this; index_++; return it; }
+		inline basic_iterator operator--(int) { basic_iterator it = *this; index_--; return it; }
+		inline basic_iterator &operator+=(difference_type n) { index_ += n; return *this; }
+		inline basic_iterator &operator-=(difference_type n) { index_ -= n; return *this; }
+		inline basic_iterator operator+(difference_type n) const { return {ring_, index_ + n}; }
+		inline basic_iterator operator-(difference_type n) const { return {ring_, index_ - n}; }
+		inline friend basic_iterator operator+(difference_type n, const basic_iterator &it) { return it + n; }
+
+		/* Iterators and const iterators can be compared with each other */
+		template <class Other>
+		inline difference_type operator-(const basic_iterator<Other> &other) const {
+			return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+		}
+
+		template <class Other> inline bool operator==(const basic_iterator<Other> &other) const { return index_ == other.index_; }
+		template <class Other> inline bool operator!=(const basic_iterator<Other> &other) const { return index_ != other.index_; }
+		template <class Other> inline bool operator<(const basic_iterator<Other> &other) const { return index_ < other.index_; }
+		template <class Other> inline bool operator>(const basic_iterator<Other> &other) const { return index_ > other.index_; }
+		template <class Other> inline bool operator<=(const basic_iterator<Other> &other) const { return index_ <= other.index_; }
+		template <class Other> inline bool operator>=(const basic_iterator<Other> &other) const { return index_ >= other.index_; }
+
+	private:
+		friend class RingBuffer;
+		template <class Other> friend class basic_iterator;
+
+		ring_type *ring_ = nullptr;
+		size_t index_ = 0; /* From the front */
+	};
+
+public:
+	using value_type = T;
+	using iterator = basic_iterator<T>;
+	using const_iterator = basic_iterator<const T>;
+
+	RingBuffer() = default;
+	~RingBuffer() { ::operator delete(data_); }
+
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	inline size_t capacity() const { return capacity_; }
+	inline size_t size() const { return size_; }
+	inline bool empty() const { return size_ == 0; }
+	inline bool full() const { return size_ == capacity_; }
+
+	/*
+	 * Replace the storage with a new allocation for capacity records, keeping
+	 * the newest records that fit. Returns false (and keeps the existing
+	 * storage) if there's not enough memory.
+	 */
+	bool allocate(size_t capacity) {
+		T *data = nullptr;
+
+		if (capacity == capacity_) {
+			return true;
+		}
+
+		if (capacity > 0) {
+			data = static_cast<T*>(::operator new(capacity * sizeof(T), std::nothrow));
+
+			if (data == nullptr) {
+				return false;
+			}
+		}
+
+		size_t size = size_ < capacity ? size_ : capacity;
+
+		for (size_t i = 0; i < size; i++) {
+			std::memcpy(&data[i], &(*this)[size_ - size + i], sizeof(T));
+		}
+
+		::operator delete(data_);
+		data_ = data;
+		capacity_ = capacity;
+		head_ = 0;
+		size_ = size;
+		return true;
+	}
+
+	inline T &operator[](size_t index) { return data_[position(index)]; }
+	inline const T &operator[](size_t index) const { return data_[position(index)]; }
+	inline T &front() { return (*this)[0]; }
+	inline const T &front() const { return (*this)[0]; }
+	inline T &back() { return (*this)[size_ - 1]; }
+	inline const T &back() const { return (*this)[size_ - 1]; }
+
+	inline iterator begin() { return {this, 0}; }
+	inline iterator end() { return {this, size_}; }
+	inline const_iterator begin() const { return {this, 0}; }
+	inline const_iterator end() const { return {this, size_}; }
+	inline const_iterator cbegin() const { return {this, 0}; }
+	inline const_iterator cend() const { return {this, size_}; }
+
+	/* The buffer must not be full */
+	inline void push_back(const T &value) {
+		std::memcpy(&data_[position(size_)], &value, sizeof(T));
+		size_++;
+	}
+
+	inline void pop_front() {
+		head_ = position(1);
+		size_--;
+	}
+
+	inline void clear() {
+		head_ = 0;
+		size_ = 0;
+	}
+
+	iterator erase(const_iterator first, const_iterator last) {
+		size_t count = last.index_ - first.index_;
+
+		if (first.index_ == 0) {
+			head_ = position(count);
+		} else {
+			for (size_t i = last.index_; i < size_; i++) {
+				std::memcpy(&(*this)[i - count], &(*this)[i], sizeof(T));
+			}
+		}
+
+		size_ -= count;
+		return {this, first.index_};
+	}
+
+private:
+	inline size_t position(size_t index) const {
+		size_t position = head_ + index;
+
+		return position >= capacity_ ? position - capacity_ : position;
+	}
+
+	T *data_ = nullptr;
+	size_t capacity_ = 0;
+	size_t head_ = 0;
+	size_t size_ = 0;
+};
+
+} // namespace scd30
@@ -1,6 +1,6 @@
 /*
  * scd30 - SCD30 Monitor
- * Copyright 2022  Simon Arlott
+ * Copyright 2022,2026  Simon Arlott
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -26,11 +26,14 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <uuid/log.h>
 #include <uuid/modbus.h>
 
 #include "report.h"
+#include "task.h"
+#include "traffic.h"
 
 namespace scd30 {
 
@@ -47,18 +50,23 @@ enum class Operation : uint8_t {
 	TAKE_MEASUREMENT,
 };
 
-enum class Measurement : uint8_t {
-	IDLE,
-	PENDING,
-	WAITING,
-};
-
 class Sensor {
 public:
 	static constexpr uint16_t MODBUS_TIMEOUT_MS = 100;
 	static constexpr uint16_t RESET_PRE_DELAY_MS = 60000;
 	static constexpr uint16_t RESET_POST_DELAY_MS = 5000;
 	static constexpr uint16_t MEASUREMENT_TIMEOUT_MS = 30000;
+	static constexpr uint16_t ALIGN_TARGET_MS = 250; /* Data ready before each scheduled read */
+	static constexpr uint16_t ALIGN_TOLERANCE_MS = 500;
+	static constexpr uint8_t ALIGN_MISSES = 3;
+	static constexpr unsigned long MINIMUM_READING_INTERVAL_S = 2;
+	static constexpr unsigned long MAXIMUM_READING_INTERVAL_S = UINT8_MAX;
+	static constexpr uint8_t ADAPTIVE_STABLE_READINGS = 3;
+	static constexpr float ADAPTIVE_SMOOTHING = 0.3f; /* Weight of each new reading */
+	static constexpr uint32_t ADAPTIVE_BASELINE_S = 60;
+	static constexpr float ADAPTIVE_NOISE_PPM = 10; /* Ignored change over the baseline */
+
+	static constexpr size_t RTU_FRAME_BYTES = 4; /* Device address, function code and CRC */
 
 	static constexpr uint8_t DEVICE_ADDRESS = 0x61;
 	static constexpr uint16_t FIRMWARE_VERSION_ADDRESS = 0x0020;
@@ -88,12 +96,23 @@ public:
 	inline float temperature_c() const { return temperature_c_; }
 	inline float relative_humidity_pc() const { return relative_humidity_pc_; }
 	inline float co2_ppm() const { return co2_ppm_; }
+	inline float dew_point_c() const { return dew_point_c_; }
+	inline float absolute_humidity_gm3() const { return absolute_humidity_gm3_; }
+	inline long data_age_ms() const { return data_age_ms_; }
+	inline uint8_t reading_interval_s() const { return reading_interval_; }
+	inline uint32_t last_reading_s() const { return last_reading_s_; }
 
 private:
-	enum class ConfigUpdate : uint8_t {
-		NONE,
-		READ,
-		WRITE,
+	/* One Modbus transaction at a time */
+	static constexpr size_t TASKS = 1;
+
+	struct Frame: public TaskFrame {
+		Operation operation = Operation::NONE;
+		std::shared_ptr<const uuid::modbus::Response> response;
+		bool response_write = false;
+		uint16_t response_registers = 0;
+		bool response_counted = false;
+		uint16_t value = 0;
 	};
 
 	static uint32_t current_time();
@@ -103,11 +122,28 @@ private:
 	static uint16_t measurement_interval();
 	static uint16_t ambient_pressure();
 
-	void update_config_register(const __FlashStringHelper *name,
+	static std::string title(const __FlashStringHelper *name);
+	static TrafficChannel traffic_channel(const Frame &frame);
+	static const std::vector<uint16_t>& response_data(const Frame &frame);
+
+	void read_registers(Frame &frame, uint16_t address, uint16_t count);
+	void write_register(Frame &frame, uint16_t address, uint16_t value);
+	bool response_done(Frame &frame);
+	TaskStatus run_operation(Frame &frame);
+	TaskStatus soft_reset_task(Frame &frame);
+	TaskStatus firmware_version_task(Frame &frame);
+	TaskStatus calibrate_task(Frame &frame);
+	TaskStatus measurement_task(Frame &frame);
+	TaskStatus config_register_task(Frame &frame, const __FlashStringHelper *name,
 		const uint16_t address, const bool always_write,
 		const std::function<uint16_t ()> &func_cfg_value,
 		const std::function<std::string (uint16_t)> &func_value_str,
 		const std::function<std::string (uint16_t)> &func_bool_value_str = std::function<std::string (uint16_t)>{});
+	void measurement(const std::vector<uint16_t> &data);
+	void check_ready();
+	void align_schedule(uint32_t age_ms);
+	void adapt_interval(uint32_t now);
+	void update_derived();
 
 	static uuid::log::Logger logger_;
 	static std::bitset<sizeof(uint32_t) * 8> config_operations_;
@@ -115,25 +151,43 @@ private:
 	uuid::modbus::SerialClient client_;
 	int ready_pin_;
 	uint8_t interval_ = 0;
+	uint8_t reading_interval_ = 0;
+	bool adaptive_ = false;
+	uint8_t minimum_interval_ = 0;
+	uint8_t maximum_interval_ = 0;
+	unsigned long rate_ppm_min_ = 0;
+	uint8_t stable_readings_ = 0;
+	float adaptive_co2_ppm_ = NAN; /* Smoothed */
+	float adaptive_base_ppm_ = NAN;
+	uint32_t adaptive_s_ = 0;
 	std::bitset<sizeof(uint32_t) * 8> pending_operations_;
-	Operation current_operation_ = Operation::NONE;
-	std::shared_ptr<const uuid::modbus::Response> response_;
-	ConfigUpdate config_update_{ConfigUpdate::NONE};
+	TaskPool<Frame, TASKS> tasks_;
 
-	uint32_t reset_start_ms_;
-	uint32_t reset_wait_ms_;
-	bool reset_complete_;
+	uint32_t reset_wait_ms_ = 0;
 	uint16_t calibration_ppm_;
 
 	uint32_t last_reading_s_ = 0;
-	uint32_t measurement_start_ms_;
-	Measurement measurement_status_ = Measurement::IDLE;
+	bool measurement_pending_ = false;
+
+	bool align_ = false;
+	bool ready_ = false;
+	bool ready_edge_valid_ = false;
+	uint32_t ready_edge_ms_ = 0;
+	bool restart_pending_ = false;
+	uint32_t restart_ms_ = 0;
+	uint32_t restart_delay_ms_ = 0;
+	bool align_due_ = false;
+	uint32_t align_at_ms_ = 0;
+	uint8_t align_misses_ = 0;
+	long data_age_ms_ = -1;
 
 	uint8_t firmware_major_ = 0;
 	uint8_t firmware_minor_ = 0;
 	float temperature_c_ = NAN;
 	float relative_humidity_pc_ = NAN;
 	float co2_ppm_ = NAN;
+	float dew_point_c_ = NAN;
+	float absolute_humidity_gm3_ = NAN;
 	Report &report_;
 };
 
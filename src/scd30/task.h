@@ -0,0 +1,163 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+namespace scd30 {
+
+enum class TaskStatus : uint8_t {
+	RUNNING,
+	DONE,
+	FAILED,
+};
+
+/*
+ * State of a stackless coroutine that is kept between calls, so that a
+ * multi-step operation can be written as a straight-line sequence.
+ *
+ * A task is a function that returns TaskStatus, with its body between
+ * TASK_BEGIN() and TASK_END(). It's called repeatedly from a loop() until
+ * it returns DONE or FAILED, resuming at the last await each time.
+ *
+ * Local variables are not preserved across an await; anything needed later
+ * must be stored in the frame. Awaits can't be used inside a switch statement
+ * or on the same line as another await.
+ */
+struct TaskFrame {
+	uint16_t resume = 0; /* Line number of the current await, 0 to start */
+	uint32_t wait_ms = 0;
+	bool timed_out = false;
+
+	inline bool started() const { return resume != 0; }
+};
+
+#define TASK_BEGIN(frame) \
+	switch ((frame).resume) { \
+	case 0:
+
+/* Resume when the condition is true */
+#define TASK_AWAIT(frame, condition) \
+	do { \
+		(frame).resume = __LINE__; \
+		__attribute__((fallthrough)); \
+	case __LINE__: \
+		if (!(condition)) { \
+			return ::scd30::TaskStatus::RUNNING; \
+		} \
+	} while (0)
+
+/* Resume when the condition is true or the timeout expires (frame.timed_out is set) */
+#define TASK_AWAIT_FOR(frame, condition, timeout_ms) \
+	do { \
+		(frame).wait_ms = ::millis(); \
+		(frame).resume = __LINE__; \
+		__attribute__((fallthrough)); \
+	case __LINE__: \
+		(frame).timed_out = !(condition); \
+		if ((frame).timed_out && ::millis() - (frame).wait_ms < static_cast<uint32_t>(timeout_ms)) { \
+			return ::scd30::TaskStatus::RUNNING; \
+		} \
+	} while (0)
+
+#define TASK_DELAY(frame, delay_ms) \
+	do { \
+		(frame).wait_ms = ::millis(); \
+		TASK_AWAIT(frame, ::millis() - (frame).wait_ms >= static_cast<uint32_t>(delay_ms)); \
+	} while (0)
+
+/* Return to the caller and resume on the next call */
+#define TASK_YIELD(frame) \
+	do { \
+		(frame).resume = __LINE__; \
+		return ::scd30::TaskStatus::RUNNING; \
+	case __LINE__: \
+		; \
+	} while (0)
+
+#define TASK_FAIL(frame) \
+	do { \
+		(frame).resume = 0; \
+		return ::scd30::TaskStatus::FAILED; \
+	} while (0)
+
+#define TASK_END(frame) \
+	} \
+	(frame).resume = 0; \
+	return ::scd30::TaskStatus::DONE;
+
+/*
+ * Fixed number of task frames, allocated without using the heap. Released
+ * frames are reinitialised so that any resources they hold are freed.
+ */
+template <class Frame, size_t Size>
+class TaskPool {
+public:
+	static_assert(Size > 0, "Task pool must not be empty");
+
+	inline size_t size() const { return Size; }
+	inline size_t used() const { return used_.count(); }
+
+	Frame *allocate() {
+		for (size_t i = 0; i < Size; i++) {
+			if (!used_[i]) {
+				used_.set(i);
+				return &frames_[i];
+			}
+		}
+
+		return nullptr;
+	}
+
+	void release(Frame *frame) {
+		size_t i = frame - frames_.data();
+
+		*frame = Frame{};
+		used_.reset(i);
+	}
+
+	void clear() {
+		for (size_t i = 0; i < Size; i++) {
+			if (used_[i]) {
+				release(&frames_[i]);
+			}
+		}
+	}
+
+	/* Resume every allocated task, releasing those that have finished */
+	template <class Function>
+	void run(Function &&function) {
+		for (size_t i = 0; i < Size; i++) {
+			if (used_[i] && function(frames_[i]) != TaskStatus::RUNNING && used_[i]) {
+				release(&frames_[i]);
+			}
+		}
+	}
+
+private:
+	std::array<Frame, Size> frames_{};
+	std::bitset<Size> used_;
+};
+
+} // namespace scd30
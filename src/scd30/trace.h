@@ -0,0 +1,103 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "quantile.h"
+
+namespace scd30 {
+
+enum class TraceStage : uint8_t {
+	READY, /* Data ready (sensor pin) */
+	READ, /* Modbus read complete */
+	STORED, /* Added to the report */
+	ENCODED, /* Encoded into an upload */
+	SENT, /* Request written */
+	ACKNOWLEDGED, /* Response received */
+};
+
+/*
+ * Tracks how long the most recent readings take to pass through each stage,
+ * from the sensor to the server acknowledging the upload. Up to TRACES
+ * readings are traced at a time, so for larger uploads the readings are
+ * sampled at an interval that spreads half of the traces across an upload
+ * (leaving the rest for readings added while it's in progress). Readings
+ * that are backfilled later are not included.
+ *
+ * The latency of a stage is the time since the previous stage.
+ */
+class LatencyTracer {
+public:
+	static constexpr size_t STAGES = static_cast<size_t>(TraceStage::ACKNOWLEDGED) + 1;
+	static constexpr size_t TRACES = 16;
+	static constexpr float MEDIAN = 0.5f;
+	static constexpr float UPPER_PERCENTILE = 0.95f;
+
+	/* "&l=" and a comma separated p50 and p95 for each stage and the total */
+	static constexpr size_t TEXT_LENGTH = 3 + STAGES * 2 * 12;
+
+	LatencyTracer();
+
+	static const __FlashStringHelper *name(TraceStage stage);
+
+	void sample(size_t upload_readings);
+	void start(uint32_t timestamp, uint32_t ready_ms, uint32_t read_ms);
+	void mark(uint32_t first, uint32_t last, TraceStage stage);
+	void store(uint32_t first, uint32_t last, uint32_t timestamp);
+	void rebase(int32_t offset);
+
+	inline uint32_t count() const { return total_p50_.count(); }
+	inline size_t interval() const { return interval_; }
+	int32_t p50(TraceStage stage) const;
+	int32_t p95(TraceStage stage) const;
+	inline int32_t total_p50() const { return total_p50_.estimate(); }
+	inline int32_t total_p95() const { return total_p95_.estimate(); }
+
+	/*
+	 * Append "&l=" and the p50 and p95 (in ms) of each stage after READY
+	 * followed by the total to text, which must have space for TEXT_LENGTH
+	 * characters. Returns the end of the text (not terminated).
+	 */
+	char *format_text(char *text) const;
+
+private:
+	struct Trace {
+		uint32_t timestamp;
+		uint8_t reached; /* Bitmask of stages */
+		uint32_t stage_ms[STAGES];
+	};
+
+	void complete(const Trace &trace);
+
+	std::array<Trace, TRACES> traces_{};
+	size_t next_ = 0;
+	size_t interval_ = 1; /* Trace every nth reading */
+	size_t skipped_ = 0;
+	QuantileSketch p50_[STAGES - 1];
+	QuantileSketch p95_[STAGES - 1];
+	QuantileSketch total_p50_;
+	QuantileSketch total_p95_;
+};
+
+} // namespace scd30
@@ -0,0 +1,89 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace scd30 {
+
+enum class TrafficChannel : uint8_t {
+	HTTP, /* Report uploads */
+	HTTPS, /* Report uploads (application data only) */
+	TLS_HANDSHAKE, /* Count only, the bytes are not visible to the application */
+	GATEWAY_UPLINK, /* Report uploads to a gateway */
+	GATEWAY, /* Readings received from peer devices */
+	MODBUS_TCP, /* Modbus server */
+	HISTORY, /* History server */
+	UART_RESET, /* Sensor Modbus operations... */
+	UART_FIRMWARE,
+	UART_CONFIG,
+	UART_CALIBRATE,
+	UART_MEASUREMENT,
+};
+
+/*
+ * Bytes sent and received since boot, split into payload (readings or
+ * register values) and overhead (protocol headers, framing and checksums).
+ *
+ * Transport layer headers (TCP/IP, UDP) are not included.
+ */
+class Traffic {
+public:
+	static constexpr size_t CHANNELS = static_cast<size_t>(TrafficChannel::UART_MEASUREMENT) + 1;
+
+	struct Usage {
+		unsigned long count; /* Requests, packets, frames or handshakes */
+		unsigned long sent_payload;
+		unsigned long sent_overhead;
+		unsigned long received_payload;
+		unsigned long received_overhead;
+	};
+
+	static inline void count(TrafficChannel channel) {
+		usage_[static_cast<size_t>(channel)].count++;
+	}
+
+	static inline void sent(TrafficChannel channel, size_t payload, size_t overhead) {
+		Usage &usage = usage_[static_cast<size_t>(channel)];
+
+		usage.sent_payload += payload;
+		usage.sent_overhead += overhead;
+	}
+
+	static inline void received(TrafficChannel channel, size_t payload, size_t overhead) {
+		Usage &usage = usage_[static_cast<size_t>(channel)];
+
+		usage.received_payload += payload;
+		usage.received_overhead += overhead;
+	}
+
+	static inline const Usage& usage(TrafficChannel channel) { return usage_[static_cast<size_t>(channel)]; }
+	static const __FlashStringHelper *name(TrafficChannel channel);
+
+	/* Average bytes per hour since boot */
+	static unsigned long hourly(unsigned long bytes);
+
+private:
+	static Usage usage_[CHANNELS];
+};
+
+} // namespace scd30
@@ -1,6 +1,6 @@
 /*
  * scd30 - SCD30 Monitor
- * Copyright 2022,2024  Simon Arlott
+ * Copyright 2022,2024,2026  Simon Arlott
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -36,7 +36,12 @@
 #include <uuid/log.h>
 
 #include "app/config.h"
+#include "scd30/boot.h"
+#include "scd30/counters.h"
+#include "scd30/psychrometrics.h"
 #include "scd30/report.h"
+#include "scd30/task.h"
+#include "scd30/traffic.h"
 
 using Config = ::app::Config;
 
@@ -89,18 +94,42 @@ void Sensor::config(std::initializer_list<Operation> operations) {
 	}
 
 	interval_ = std::max(0UL, std::min(static_cast<unsigned long>(UINT8_MAX), config.take_measurement_interval()));
+	adaptive_ = config.take_measurement_adaptive();
+	/* Reading more often than the sensor measures would only repeat values */
+	minimum_interval_ = std::min(MAXIMUM_READING_INTERVAL_S,
+		std::max(std::max(MINIMUM_READING_INTERVAL_S, static_cast<unsigned long>(measurement_interval())),
+			config.take_measurement_minimum_interval()));
+	maximum_interval_ = std::max(static_cast<unsigned long>(minimum_interval_),
+		std::min(MAXIMUM_READING_INTERVAL_S, config.take_measurement_maximum_interval()));
+	rate_ppm_min_ = config.take_measurement_rate();
+
+	if (adaptive_ && interval_ != 0) {
+		reading_interval_ = std::max(minimum_interval_, std::min(maximum_interval_, interval_));
+	} else {
+		reading_interval_ = interval_;
+	}
+
+	stable_readings_ = 0;
+	adaptive_co2_ppm_ = NAN;
+	adaptive_base_ppm_ = NAN;
+	align_ = config.take_measurement_align();
+	align_misses_ = 0;
 }
 
 void Sensor::reset(uint32_t wait_ms) {
+	Counters::increment(Counter::MODBUS_ERRORS);
+	tasks_.clear();
 	pending_operations_.reset();
 	pending_operations_.set(static_cast<size_t>(Operation::SOFT_RESET));
-	current_operation_ = Operation::NONE;
-	response_.reset();
 	start();
-	reset_start_ms_ = ::millis();
 	reset_wait_ms_ = wait_ms;
 	last_reading_s_ = 0;
-	measurement_status_ = Measurement::PENDING;
+	measurement_pending_ = true;
+	ready_edge_valid_ = false;
+	restart_pending_ = false;
+	restart_delay_ms_ = 0;
+	align_due_ = false;
+	data_age_ms_ = -1;
 }
 
 uint32_t Sensor::current_time() {
@@ -113,82 +142,285 @@ uint32_t Sensor::current_time() {
 	}
 }
 
+std::string Sensor::title(const __FlashStringHelper *name) {
+	std::string text = uuid::read_flash_string(name);
+
+	text[0] = ::toupper(text[0]);
+	return text;
+}
+
+TrafficChannel Sensor::traffic_channel(const Frame &frame) {
+	switch (frame.operation) {
+	case Operation::SOFT_RESET:
+		return TrafficChannel::UART_RESET;
+
+	case Operation::READ_FIRMWARE_VERSION:
+		return TrafficChannel::UART_FIRMWARE;
+
+	case Operation::CALIBRATE:
+		return TrafficChannel::UART_CALIBRATE;
+
+	case Operation::TAKE_MEASUREMENT:
+		return TrafficChannel::UART_MEASUREMENT;
+
+	case Operation::NONE:
+	case Operation::CONFIG_AUTOMATIC_CALIBRATION:
+	case Operation::CONFIG_TEMPERATURE_OFFSET:
+	case Operation::CONFIG_ALTITUDE_COMPENSATION:
+	case Operation::CONFIG_CONTINUOUS_MEASUREMENT:
+	case Operation::CONFIG_AMBIENT_PRESSURE:
+		break;
+	}
+
+	return TrafficChannel::UART_CONFIG;
+}
+
+void Sensor::read_registers(Frame &frame, uint16_t address, uint16_t count) {
+	frame.response = client_.read_holding_registers(DEVICE_ADDRESS, address, count);
+	frame.response_write = false;
+	frame.response_registers = count;
+	frame.response_counted = false;
+
+	/* Register address and quantity */
+	Traffic::count(traffic_channel(frame));
+	Traffic::sent(traffic_channel(frame), 0, RTU_FRAME_BYTES + 4);
+}
+
+void Sensor::write_register(Frame &frame, uint16_t address, uint16_t value) {
+	frame.response = client_.write_holding_register(DEVICE_ADDRESS, address, value);
+	frame.response_write = true;
+	frame.response_registers = 1;
+	frame.response_counted = false;
+
+	/* Register address and value */
+	Traffic::count(traffic_channel(frame));
+	Traffic::sent(traffic_channel(frame), 2, RTU_FRAME_BYTES + 2);
+}
+
+bool Sensor::response_done(Frame &frame) {
+	if (!frame.response->done()) {
+		return false;
+	}
+
+	if (!frame.response_counted) {
+		/*
+		 * The client doesn't report what was received for a failed
+		 * response (timeout, exception or CRC error) so only count
+		 * successful responses.
+		 */
+		if (frame.response_write) {
+			if (response_data(frame).size() >= 1) {
+				/* Echo of the register address and value */
+				Traffic::received(traffic_channel(frame), 2, RTU_FRAME_BYTES + 2);
+			}
+		} else {
+			if (response_data(frame).size() >= frame.response_registers) {
+				/* Byte count and register values */
+				Traffic::received(traffic_channel(frame), frame.response_registers * 2, RTU_FRAME_BYTES + 1);
+			}
+		}
+
+		frame.response_counted = true;
+	}
+
+	return true;
+}
+
+const std::vector<uint16_t>& Sensor::response_data(const Frame &frame) {
+	if (frame.response_write) {
+		return std::static_pointer_cast<const uuid::modbus::RegisterWriteResponse>(frame.response)->data();
+	} else {
+		return std::static_pointer_cast<const uuid::modbus::RegisterDataResponse>(frame.response)->data();
+	}
+}
+
+void Sensor::check_ready() {
+	bool ready = digitalRead(ready_pin_) == HIGH;
+
+	if (ready && !ready_) {
+		ready_edge_ms_ = ::millis();
+		ready_edge_valid_ = true;
+
+		if (restart_pending_) {
+			restart_delay_ms_ = ready_edge_ms_ - restart_ms_;
+			restart_pending_ = false;
+			logger_.trace(F("Measurement ready %lums after restart"), static_cast<unsigned long>(restart_delay_ms_));
+		}
+	}
+
+	ready_ = ready;
+
+	if (align_due_ && !measurement_pending_
+			&& static_cast<int32_t>(::millis() - align_at_ms_) >= 0) {
+		logger_.debug(F("Restarting continuous measurement to align with reading schedule"));
+		pending_operations_.set(static_cast<size_t>(Operation::CONFIG_AMBIENT_PRESSURE));
+		align_due_ = false;
+	}
+}
+
+/*
+ * The sensor measures on its own cadence so a reading could be up to a whole
+ * measurement interval old. When that happens repeatedly, restart continuous
+ * measurement so that new data becomes ready just before each scheduled read.
+ * This is only possible when the reading interval is a multiple of the
+ * measurement interval.
+ */
+void Sensor::align_schedule(uint32_t age_ms) {
+	if (!align_ || reading_interval_ == 0 || align_due_ || restart_pending_) {
+		return;
+	}
+
+	uint16_t cadence_s = measurement_interval();
+
+	if (reading_interval_ % cadence_s != 0) {
+		return;
+	}
+
+	if (age_ms <= ALIGN_TARGET_MS + ALIGN_TOLERANCE_MS) {
+		align_misses_ = 0;
+		return;
+	}
+
+	if (++align_misses_ < ALIGN_MISSES) {
+		return;
+	}
+
+	struct timeval tv;
+
+	if (gettimeofday(&tv, nullptr) != 0) {
+		return;
+	}
+
+	uint32_t next_read_ms = (reading_interval_ - tv.tv_sec % reading_interval_) * 1000UL - tv.tv_usec / 1000;
+	uint32_t lead_ms = (restart_delay_ms_ != 0 ? restart_delay_ms_ : cadence_s * 1000UL) + ALIGN_TARGET_MS;
+
+	while (next_read_ms < lead_ms) {
+		next_read_ms += reading_interval_ * 1000UL;
+	}
+
+	logger_.debug(F("Data age %lums, restarting measurement in %lums"),
+		static_cast<unsigned long>(age_ms), static_cast<unsigned long>(next_read_ms - lead_ms));
+	align_at_ms_ = ::millis() + (next_read_ms - lead_ms);
+	align_due_ = true;
+	align_misses_ = 0;
+}
+
+/*
+ * Read as often as possible while the CO₂ concentration is changing quickly,
+ * then back off (doubling the interval) once it has been stable for a few
+ * baselines.
+ *
+ * The rate of change is measured on a smoothed concentration against a
+ * baseline that is kept for ADAPTIVE_BASELINE_S, ignoring changes within the
+ * noise of the sensor. A fast change is acted on as soon as it exceeds the
+ * noise, without waiting for the whole baseline.
+ */
+void Sensor::adapt_interval(uint32_t now) {
+	if (!adaptive_ || reading_interval_ == 0) {
+		return;
+	}
+
+	if (std::isnan(co2_ppm_)) {
+		adaptive_co2_ppm_ = NAN;
+		adaptive_base_ppm_ = NAN;
+		return;
+	}
+
+	if (std::isnan(adaptive_co2_ppm_)) {
+		adaptive_co2_ppm_ = co2_ppm_;
+	} else {
+		adaptive_co2_ppm_ += (co2_ppm_ - adaptive_co2_ppm_) * ADAPTIVE_SMOOTHING;
+	}
+
+	if (std::isnan(adaptive_base_ppm_) || now < adaptive_s_) {
+		adaptive_base_ppm_ = adaptive_co2_ppm_;
+		adaptive_s_ = now;
+		return;
+	}
+
+	if (now == adaptive_s_) {
+		return;
+	}
+
+	float change = std::max(0.0f, std::fabs(adaptive_co2_ppm_ - adaptive_base_ppm_) - ADAPTIVE_NOISE_PPM);
+	float rate = change * 60 / (now - adaptive_s_);
+	uint8_t interval = reading_interval_;
+
+	if (rate >= rate_ppm_min_) {
+		interval = minimum_interval_;
+		stable_readings_ = 0;
+	} else if (now - adaptive_s_ < ADAPTIVE_BASELINE_S) {
+		return;
+	} else if (rate < rate_ppm_min_ / 2.0f) {
+		if (++stable_readings_ >= ADAPTIVE_STABLE_READINGS) {
+			interval = std::min(static_cast<unsigned int>(maximum_interval_), reading_interval_ * 2U);
+			stable_readings_ = 0;
+		}
+	} else {
+		stable_readings_ = 0;
+	}
+
+	if (interval != reading_interval_) {
+		logger_.debug(F("CO₂ changing at %.1f ppm/min, reading interval %us"), rate, interval);
+		reading_interval_ = interval;
+	}
+
+	adaptive_base_ppm_ = adaptive_co2_ppm_;
+	adaptive_s_ = now;
+}
+
 void Sensor::loop() {
 	client_.loop();
+	check_ready();
 
-	if (measurement_status_ == Measurement::IDLE && interval_ > 0) {
+	if (!measurement_pending_ && reading_interval_ > 0) {
 		uint32_t now = current_time();
 
-		if (now > last_reading_s_ && now % interval_ == 0) {
+		if (now > last_reading_s_ && now % reading_interval_ == 0) {
 			logger_.trace(F("Take measurement"));
 			pending_operations_.set(static_cast<size_t>(Operation::TAKE_MEASUREMENT));
-			measurement_status_ = Measurement::PENDING;
+			measurement_pending_ = true;
 		}
 	}
 
-retry:
-	switch (current_operation_) {
-	case Operation::NONE:
-		if (pending_operations_.any()) {
-			int bit = ffs(pending_operations_.to_ulong());
-			if (bit != 0) {
-				current_operation_ = static_cast<Operation>(bit - 1);
-				pending_operations_.reset(static_cast<size_t>(current_operation_));
-			}
-			goto retry;
-		}
-		break;
+	if (tasks_.used() == 0 && pending_operations_.any()) {
+		int bit = ffs(pending_operations_.to_ulong());
 
-	case Operation::SOFT_RESET:
-		if (!response_) {
-			if (::millis() - reset_start_ms_ >= reset_wait_ms_) {
-				logger_.debug(F("Restarting sensor"));
-				response_ = client_.write_holding_register(DEVICE_ADDRESS, SOFT_RESET_ADDRESS, 0x0001);
-				reset_complete_ = false;
-			}
-		} else if (response_->done()) {
-			auto write_response = std::static_pointer_cast<const uuid::modbus::RegisterWriteResponse>(response_);
-
-			if (write_response->data().size() < 1 || write_response->data()[0] != 0x0001) {
-				logger_.emerg(F("Failed to restart sensor"));
-				reset();
-				return;
-			} else if (!reset_complete_) {
-				logger_.info(F("Restarted sensor"));
-				reset_start_ms_ = ::millis();
-				reset_complete_ = true;
-			} else {
-				if (::millis() - reset_start_ms_ >= RESET_POST_DELAY_MS) {
-					response_.reset();
-					current_operation_ = Operation::NONE;
-					measurement_status_ = Measurement::IDLE;
-				}
-			}
+		if (bit != 0) {
+			Frame *frame = tasks_.allocate();
+
+			frame->operation = static_cast<Operation>(bit - 1);
+			pending_operations_.reset(static_cast<size_t>(frame->operation));
 		}
-		break;
+	}
 
-	case Operation::READ_FIRMWARE_VERSION:
-		if (!response_) {
-			logger_.debug(F("Reading firmware version"));
-			response_ = client_.read_holding_registers(DEVICE_ADDRESS, FIRMWARE_VERSION_ADDRESS, 1);
-		} else if (response_->done()) {
-			auto response = std::static_pointer_cast<const uuid::modbus::RegisterDataResponse>(response_);
-
-			if (response->data().size() < 1) {
-				logger_.warning(F("Failed to read firmware version"));
-				reset();
-				return;
-			} else {
-				firmware_major_ = response->data()[0] >> 8;
-				firmware_minor_ = response->data()[0] & 0xFF;
-				logger_.debug(F("Firmware version: %u.%u"), firmware_major_, firmware_minor_);
-			}
+	bool failed = false;
+
+	tasks_.run([this, &failed] (Frame &frame) {
+		TaskStatus status = run_operation(frame);
 
-			response_.reset();
-			current_operation_ = Operation::NONE;
+		if (status == TaskStatus::FAILED) {
+			failed = true;
 		}
+		return status;
+	});
+
+	if (failed) {
+		reset();
+	}
+}
+
+TaskStatus Sensor::run_operation(Frame &frame) {
+	switch (frame.operation) {
+	case Operation::NONE:
 		break;
 
+	case Operation::SOFT_RESET:
+		return soft_reset_task(frame);
+
+	case Operation::READ_FIRMWARE_VERSION:
+		return firmware_version_task(frame);
+
 	case Operation::CONFIG_AUTOMATIC_CALIBRATION:
 		static const auto bool_value_str = [] (uint16_t value) -> std::string {
 				return uuid::read_flash_string(value ? F("enabled") : F("disabled"));
@@ -197,9 +429,8 @@ retry:
 				return uuid::read_flash_string(value ? F("Enabling") : F("Disabling"));
 			};
 
-		update_config_register(F("automatic calibration"), ASC_CONFIG_ADDRESS,
+		return config_register_task(frame, F("automatic calibration"), ASC_CONFIG_ADDRESS,
 			false, &automatic_calibration, bool_value_str, bool_set_value_str);
-		break;
 
 	case Operation::CONFIG_TEMPERATURE_OFFSET:
 		static const auto temp_value_str = [] (uint16_t value) -> std::string {
@@ -210,9 +441,8 @@ retry:
 				return text.data();
 			};
 
-		update_config_register(F("temperature offset"), TEMPERATURE_OFFSET_ADDRESS,
+		return config_register_task(frame, F("temperature offset"), TEMPERATURE_OFFSET_ADDRESS,
 			false, &temperature_offset, temp_value_str);
-		break;
 
 	case Operation::CONFIG_ALTITUDE_COMPENSATION:
 		static const auto alt_value_str = [] (uint16_t value) -> std::string {
@@ -223,9 +453,8 @@ retry:
 				return text.data();
 			};
 
-		update_config_register(F("altitude compensation"), ALTITUDE_COMPENSATION_ADDRESS,
+		return config_register_task(frame, F("altitude compensation"), ALTITUDE_COMPENSATION_ADDRESS,
 			false, &altitude_compensation, alt_value_str);
-		break;
 
 	case Operation::CONFIG_CONTINUOUS_MEASUREMENT:
 		static const auto secs_value_str = [] (uint16_t value) -> std::string {
@@ -236,9 +465,8 @@ retry:
 				return text.data();
 			};
 
-		update_config_register(F("measurement interval"), MEASUREMENT_INTERVAL_ADDRESS,
+		return config_register_task(frame, F("measurement interval"), MEASUREMENT_INTERVAL_ADDRESS,
 			false, &measurement_interval, secs_value_str);
-		break;
 
 	case Operation::CONFIG_AMBIENT_PRESSURE:
 		static const auto pressure_value_str = [] (uint16_t value) -> std::string {
@@ -249,137 +477,210 @@ retry:
 				return text.data();
 			};
 
-		update_config_register(F("continuous measurement with ambient pressure"), AMBIENT_PRESSURE_ADDRESS,
-			true, &ambient_pressure, pressure_value_str);
-		break;
+		{
+			TaskStatus status = config_register_task(frame, F("continuous measurement with ambient pressure"),
+				AMBIENT_PRESSURE_ADDRESS, true, &ambient_pressure, pressure_value_str);
 
-	case Operation::CALIBRATE:
-		if (!response_) {
-			logger_.info(F("Writing calibration value of %u ppm"), calibration_ppm_);
-			response_ = client_.write_holding_register(DEVICE_ADDRESS, FORCED_RECALIBRATION_ADDRESS, calibration_ppm_);
-		} else if (response_->done()) {
-			auto response = std::static_pointer_cast<const uuid::modbus::RegisterWriteResponse>(response_);
-
-			if (response->data().size() < 1) {
-				logger_.crit(F("Failed to set calibration value"));
-				reset();
-				return;
-			} else {
-				logger_.info(F("Calibrated CO₂ ppm: %u"), response->data()[0]);
+			if (status == TaskStatus::DONE) {
+				/* Measure the delay until the first data from the new cadence */
+				restart_pending_ = true;
+				ready_edge_valid_ = false;
 			}
-
-			response_.reset();
-			current_operation_ = Operation::NONE;
+			return status;
 		}
-		break;
+
+	case Operation::CALIBRATE:
+		return calibrate_task(frame);
 
 	case Operation::TAKE_MEASUREMENT:
-		if (!response_) {
-			if (digitalRead(ready_pin_) == HIGH) {
-				logger_.trace(F("Read measurement data"));
-				response_ = client_.read_holding_registers(DEVICE_ADDRESS, MEASUREMENT_DATA_ADDRESS, 6);
-			} else if (measurement_status_ == Measurement::WAITING) {
-				if (::millis() - measurement_start_ms_ >= MEASUREMENT_TIMEOUT_MS) {
-					logger_.alert(F("Timeout waiting for measurement to be ready"));
-					reset();
-					return;
-				}
-			} else {
-				measurement_status_ = Measurement::WAITING;
-				measurement_start_ms_ = ::millis();
-			}
-		} else if (response_->done()) {
-			auto response = std::static_pointer_cast<const uuid::modbus::RegisterDataResponse>(response_);
-
-			if (response->data().size() < 6) {
-				logger_.alert(F("Failed to read measurement data"));
-				reset();
-				return;
-			} else {
-				uint32_t now = current_time();
-				float co2 = convert_f(&response->data()[0]);
-				temperature_c_ = convert_f(&response->data()[2]);
-				relative_humidity_pc_ = convert_f(&response->data()[4]);
-
-				logger_.debug(F("Temperature %.2f°C, Relative humidity %.2f%%, CO₂ %.2f ppm"),
-					temperature_c_, relative_humidity_pc_, co2);
-
-				if (co2 >= MINIMUM_CO2_PPM) {
-					co2_ppm_ = co2;
-				} else {
-					co2_ppm_ = NAN;
-				}
+		return measurement_task(frame);
+	}
 
-				report_.add(now, temperature_c_, relative_humidity_pc_, co2_ppm_);
+	return TaskStatus::DONE;
+}
 
-				last_reading_s_ = now;
-				measurement_status_ = Measurement::IDLE;
-			}
+TaskStatus Sensor::soft_reset_task(Frame &frame) {
+	TASK_BEGIN(frame);
+	TASK_DELAY(frame, reset_wait_ms_);
 
-			response_.reset();
-			current_operation_ = Operation::NONE;
-		}
-		break;
+	logger_.debug(F("Restarting sensor"));
+	write_register(frame, SOFT_RESET_ADDRESS, 0x0001);
+	TASK_AWAIT(frame, response_done(frame));
+
+	if (response_data(frame).size() < 1 || response_data(frame)[0] != 0x0001) {
+		logger_.emerg(F("Failed to restart sensor"));
+		TASK_FAIL(frame);
 	}
+
+	logger_.info(F("Restarted sensor"));
+	TASK_DELAY(frame, RESET_POST_DELAY_MS);
+
+	measurement_pending_ = false;
+	TASK_END(frame);
 }
 
-void Sensor::update_config_register(const __FlashStringHelper *name,
+TaskStatus Sensor::firmware_version_task(Frame &frame) {
+	TASK_BEGIN(frame);
+	logger_.debug(F("Reading firmware version"));
+	read_registers(frame, FIRMWARE_VERSION_ADDRESS, 1);
+	TASK_AWAIT(frame, response_done(frame));
+
+	if (response_data(frame).size() < 1) {
+		logger_.warning(F("Failed to read firmware version"));
+		TASK_FAIL(frame);
+	}
+
+	firmware_major_ = response_data(frame)[0] >> 8;
+	firmware_minor_ = response_data(frame)[0] & 0xFF;
+	logger_.debug(F("Firmware version: %u.%u"), firmware_major_, firmware_minor_);
+	BootTiming::mark(BootPhase::SENSOR_FIRMWARE);
+	TASK_END(frame);
+}
+
+TaskStatus Sensor::calibrate_task(Frame &frame) {
+	TASK_BEGIN(frame);
+	logger_.info(F("Writing calibration value of %u ppm"), calibration_ppm_);
+	write_register(frame, FORCED_RECALIBRATION_ADDRESS, calibration_ppm_);
+	TASK_AWAIT(frame, response_done(frame));
+
+	if (response_data(frame).size() < 1) {
+		logger_.crit(F("Failed to set calibration value"));
+		TASK_FAIL(frame);
+	}
+
+	logger_.info(F("Calibrated CO₂ ppm: %u"), response_data(frame)[0]);
+	TASK_END(frame);
+}
+
+TaskStatus Sensor::measurement_task(Frame &frame) {
+	TASK_BEGIN(frame);
+	TASK_AWAIT_FOR(frame, digitalRead(ready_pin_) == HIGH, MEASUREMENT_TIMEOUT_MS);
+
+	if (frame.timed_out) {
+		logger_.alert(F("Timeout waiting for measurement to be ready"));
+		TASK_FAIL(frame);
+	}
+
+	logger_.trace(F("Read measurement data"));
+	read_registers(frame, MEASUREMENT_DATA_ADDRESS, 6);
+	TASK_AWAIT(frame, response_done(frame));
+
+	if (response_data(frame).size() < 6) {
+		logger_.alert(F("Failed to read measurement data"));
+		TASK_FAIL(frame);
+	}
+
+	measurement(response_data(frame));
+	TASK_END(frame);
+}
+
+void Sensor::measurement(const std::vector<uint16_t> &data) {
+	uint32_t now = current_time();
+	uint32_t read_ms = ::millis();
+	float co2 = convert_f(&data[0]);
+	temperature_c_ = convert_f(&data[2]);
+	relative_humidity_pc_ = convert_f(&data[4]);
+
+	logger_.debug(F("Temperature %.2f°C, Relative humidity %.2f%%, CO₂ %.2f ppm"),
+		temperature_c_, relative_humidity_pc_, co2);
+
+	if (co2 >= MINIMUM_CO2_PPM) {
+		co2_ppm_ = co2;
+	} else {
+		co2_ppm_ = NAN;
+	}
+
+	update_derived();
+
+	if (ready_edge_valid_) {
+		/*
+		 * The ready pin stays high until the data is read, so
+		 * newer measurements may have replaced the data since
+		 * it first became ready.
+		 */
+		data_age_ms_ = (read_ms - ready_edge_ms_) % (measurement_interval() * 1000UL);
+		ready_edge_valid_ = false;
+		logger_.trace(F("Data age %ldms"), data_age_ms_);
+		align_schedule(data_age_ms_);
+	} else {
+		data_age_ms_ = -1;
+	}
+
+	BootTiming::mark(BootPhase::FIRST_READING);
+	report_.add(now, temperature_c_, relative_humidity_pc_, co2_ppm_,
+		data_age_ms_ >= 0 ? read_ms - data_age_ms_ : read_ms, read_ms);
+
+	last_reading_s_ = now;
+	measurement_pending_ = false;
+	adapt_interval(now);
+}
+
+void Sensor::update_derived() {
+	int32_t temperature_c = Reading::encode<Reading::TEMPERATURE>(temperature_c_);
+	int32_t relative_humidity_pc = Reading::encode<Reading::RELATIVE_HUMIDITY>(relative_humidity_pc_);
+	int32_t value;
+
+	value = psychrometrics::dew_point(temperature_c, relative_humidity_pc);
+	if (value != psychrometrics::DERIVED_FIELDS[psychrometrics::DEW_POINT].nan()) {
+		dew_point_c_ = value / static_cast<float>(psychrometrics::DERIVED_FIELDS[psychrometrics::DEW_POINT].div);
+	} else {
+		dew_point_c_ = NAN;
+	}
+
+	value = psychrometrics::absolute_humidity(temperature_c, relative_humidity_pc);
+	if (value != psychrometrics::DERIVED_FIELDS[psychrometrics::ABSOLUTE_HUMIDITY].nan()) {
+		absolute_humidity_gm3_ = value / static_cast<float>(psychrometrics::DERIVED_FIELDS[psychrometrics::ABSOLUTE_HUMIDITY].div);
+	} else {
+		absolute_humidity_gm3_ = NAN;
+	}
+}
+
+TaskStatus Sensor::config_register_task(Frame &frame, const __FlashStringHelper *name,
 		const uint16_t address, const bool always_write,
 		const std::function<uint16_t ()> &func_cfg_value,
 		const std::function<std::string (uint16_t)> &func_value_str,
 		const std::function<std::string (uint16_t)> &func_bool_cfg_str) {
-	if (!response_) {
-		logger_.debug(F("Reading %S configuration"), name);
-		response_ = client_.read_holding_registers(DEVICE_ADDRESS, address, 1);
-		config_update_ = ConfigUpdate::READ;
-	} else if (response_->done()) {
-		if (config_update_ == ConfigUpdate::WRITE) {
-			auto write_response = std::static_pointer_cast<const uuid::modbus::RegisterWriteResponse>(response_);
-
-			if (write_response->data().size() < 1) {
-				logger_.crit(F("Failed to write %S configuration"), name);
-				reset();
-				return;
-			} else {
-				std::string name_title = uuid::read_flash_string(name);
-
-				name_title[0] = ::toupper(name_title[0]);
-
-				logger_.info(F("%s %s"), name_title.c_str(), func_value_str(write_response->data()[0]).c_str());
-			}
-		} else if (config_update_ == ConfigUpdate::READ) {
-			auto read_response = std::static_pointer_cast<const uuid::modbus::RegisterDataResponse>(response_);
-
-			if (read_response->data().size() < 1) {
-				logger_.crit(F("Failed to read %S configuration"), name);
-				reset();
-				return;
-			} else {
-				const uint16_t value = func_cfg_value();
-
-				if (read_response->data()[0] == value && !always_write) {
-					std::string name_title = uuid::read_flash_string(name);
-
-					name_title[0] = ::toupper(name_title[0]);
-
-					logger_.debug(F("%s %s"), name_title.c_str(), func_value_str(read_response->data()[0]).c_str());
-				} else {
-					if (func_bool_cfg_str) {
-						logger_.info(F("%S %s"), name, func_bool_cfg_str(value).c_str());
-					} else {
-						logger_.info(F("Setting %S to %s"), name, func_value_str(value).c_str());
-					}
-					response_ = client_.write_holding_register(DEVICE_ADDRESS, address, value);
-					config_update_ = ConfigUpdate::WRITE;
-					return;
-				}
-			}
+	TASK_BEGIN(frame);
+	logger_.debug(F("Reading %S configuration"), name);
+	read_registers(frame, address, 1);
+	TASK_AWAIT(frame, response_done(frame));
+
+	if (response_data(frame).size() < 1) {
+		logger_.crit(F("Failed to read %S configuration"), name);
+		TASK_FAIL(frame);
+	}
+
+	frame.value = func_cfg_value();
+
+	if (response_data(frame)[0] == frame.value && !always_write) {
+		logger_.debug(F("%s %s"), title(name).c_str(), func_value_str(response_data(frame)[0]).c_str());
+	} else {
+		if (func_bool_cfg_str) {
+			logger_.info(F("%S %s"), name, func_bool_cfg_str(frame.value).c_str());
+		} else {
+			logger_.info(F("Setting %S to %s"), name, func_value_str(frame.value).c_str());
+		}
+
+		if (address == AMBIENT_PRESSURE_ADDRESS) {
+			/* Writing this (re)starts continuous measurement */
+			restart_ms_ = ::millis();
 		}
 
-		response_.reset();
-		config_update_ = ConfigUpdate::NONE;
-		current_operation_ = Operation::NONE;
+		write_register(frame, address, frame.value);
+		TASK_AWAIT(frame, response_done(frame));
+
+		if (response_data(frame).size() < 1) {
+			logger_.crit(F("Failed to write %S configuration"), name);
+			TASK_FAIL(frame);
+		}
+
+		logger_.info(F("%s %s"), title(name).c_str(), func_value_str(response_data(frame)[0]).c_str());
+	}
+
+	if ((pending_operations_ & config_operations_).none()) {
+		BootTiming::mark(BootPhase::SENSOR_CONFIG);
 	}
+	TASK_END(frame);
 }
 
 uint16_t Sensor::automatic_calibration() {
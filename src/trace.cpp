@@ -0,0 +1,171 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/trace.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "scd30/quantile.h"
+
+namespace scd30 {
+
+constexpr float LatencyTracer::MEDIAN;
+constexpr float LatencyTracer::UPPER_PERCENTILE;
+
+LatencyTracer::LatencyTracer() : total_p50_(MEDIAN), total_p95_(UPPER_PERCENTILE) {
+	for (size_t i = 0; i < STAGES - 1; i++) {
+		p50_[i] = QuantileSketch{MEDIAN};
+		p95_[i] = QuantileSketch{UPPER_PERCENTILE};
+	}
+}
+
+const __FlashStringHelper *LatencyTracer::name(TraceStage stage) {
+	switch (stage) {
+	case TraceStage::READY:
+		return F("ready");
+
+	case TraceStage::READ:
+		return F("read");
+
+	case TraceStage::STORED:
+		return F("stored");
+
+	case TraceStage::ENCODED:
+		return F("encoded");
+
+	case TraceStage::SENT:
+		return F("sent");
+
+	case TraceStage::ACKNOWLEDGED:
+		return F("acknowledged");
+	}
+
+	return F("unknown");
+}
+
+void LatencyTracer::sample(size_t upload_readings) {
+	constexpr size_t upload_traces = TRACES / 2;
+
+	interval_ = std::max(static_cast<size_t>(1), (upload_readings + upload_traces - 1) / upload_traces);
+	skipped_ = 0;
+}
+
+void LatencyTracer::start(uint32_t timestamp, uint32_t ready_ms, uint32_t read_ms) {
+	if (skipped_ + 1 < interval_) {
+		skipped_++;
+		return;
+	}
+
+	Trace &trace = traces_[next_];
+
+	skipped_ = 0;
+
+	trace.timestamp = timestamp;
+	trace.reached = (1U << static_cast<size_t>(TraceStage::READY)) | (1U << static_cast<size_t>(TraceStage::READ));
+	trace.stage_ms[static_cast<size_t>(TraceStage::READY)] = ready_ms;
+	trace.stage_ms[static_cast<size_t>(TraceStage::READ)] = read_ms;
+
+	next_ = (next_ + 1) % TRACES;
+}
+
+void LatencyTracer::mark(uint32_t first, uint32_t last, TraceStage stage) {
+	size_t index = static_cast<size_t>(stage);
+	uint32_t now_ms = ::millis();
+
+	for (auto &trace : traces_) {
+		if (trace.timestamp < first || trace.timestamp > last) {
+			continue;
+		}
+
+		/* Stages are only recorded in order, and only the first time */
+		if (!(trace.reached & (1U << (index - 1))) || (trace.reached & (1U << index))) {
+			continue;
+		}
+
+		trace.reached |= 1U << index;
+		trace.stage_ms[index] = now_ms;
+
+		if (stage == TraceStage::ACKNOWLEDGED) {
+			complete(trace);
+			trace.reached = 0;
+		}
+	}
+}
+
+void LatencyTracer::store(uint32_t first, uint32_t last, uint32_t timestamp) {
+	for (auto &trace : traces_) {
+		if (trace.timestamp >= first && trace.timestamp <= last) {
+			trace.timestamp = timestamp;
+		}
+	}
+
+	mark(timestamp, timestamp, TraceStage::STORED);
+}
+
+void LatencyTracer::rebase(int32_t offset) {
+	for (auto &trace : traces_) {
+		if (trace.reached) {
+			trace.timestamp += offset;
+		}
+	}
+}
+
+void LatencyTracer::complete(const Trace &trace) {
+	for (size_t i = 1; i < STAGES; i++) {
+		int32_t latency_ms = trace.stage_ms[i] - trace.stage_ms[i - 1];
+
+		p50_[i - 1].add(latency_ms);
+		p95_[i - 1].add(latency_ms);
+	}
+
+	int32_t total_ms = trace.stage_ms[STAGES - 1] - trace.stage_ms[0];
+
+	total_p50_.add(total_ms);
+	total_p95_.add(total_ms);
+}
+
+int32_t LatencyTracer::p50(TraceStage stage) const {
+	return stage == TraceStage::READY ? 0 : p50_[static_cast<size_t>(stage) - 1].estimate();
+}
+
+int32_t LatencyTracer::p95(TraceStage stage) const {
+	return stage == TraceStage::READY ? 0 : p95_[static_cast<size_t>(stage) - 1].estimate();
+}
+
+char *LatencyTracer::format_text(char *text) const {
+	*text++ = '&';
+	*text++ = 'l';
+	*text++ = '=';
+
+	for (size_t i = 0; i < STAGES; i++) {
+		const QuantileSketch &p50 = i < STAGES - 1 ? p50_[i] : total_p50_;
+		const QuantileSketch &p95 = i < STAGES - 1 ? p95_[i] : total_p95_;
+
+		text += ::snprintf_P(text, 2 * 12 + 1, i == 0 ? PSTR("%ld,%ld") : PSTR(",%ld,%ld"),
+			static_cast<long>(p50.estimate()), static_cast<long>(p95.estimate()));
+	}
+
+	return text;
+}
+
+} // namespace scd30
@@ -0,0 +1,84 @@
+/*
+ * scd30 - SCD30 Monitor
+ * Copyright 2026  Simon Arlott
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scd30/traffic.h"
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <uuid/common.h>
+
+namespace scd30 {
+
+Traffic::Usage Traffic::usage_[CHANNELS];
+
+const __FlashStringHelper *Traffic::name(TrafficChannel channel) {
+	switch (channel) {
+	case TrafficChannel::HTTP:
+		return F("HTTP");
+
+	case TrafficChannel::HTTPS:
+		return F("HTTPS");
+
+	case TrafficChannel::TLS_HANDSHAKE:
+		return F("TLS handshake");
+
+	case TrafficChannel::GATEWAY_UPLINK:
+		return F("Gateway uplink");
+
+	case TrafficChannel::GATEWAY:
+		return F("Gateway");
+
+	case TrafficChannel::MODBUS_TCP:
+		return F("Modbus TCP");
+
+	case TrafficChannel::HISTORY:
+		return F("History");
+
+	case TrafficChannel::UART_RESET:
+		return F("Sensor reset");
+
+	case TrafficChannel::UART_FIRMWARE:
+		return F("Sensor firmware");
+
+	case TrafficChannel::UART_CONFIG:
+		return F("Sensor config");
+
+	case TrafficChannel::UART_CALIBRATE:
+		return F("Sensor calibrate");
+
+	case TrafficChannel::UART_MEASUREMENT:
+		return F("Sensor measurement");
+	}
+
+	return F("?");
+}
+
+unsigned long Traffic::hourly(unsigned long bytes) {
+	uint64_t uptime_ms = uuid::get_uptime_ms();
+
+	if (uptime_ms < 1000) {
+		return 0;
+	}
+
+	return static_cast<uint64_t>(bytes) * 3600000ULL / uptime_ms;
+}
+
+} // namespace scd30